@@ -0,0 +1,133 @@
+/*
+ * buffered_uart_throughput_demo.cpp - Motate
+ * This file is part of the Motate project.
+ *
+ * Copyright (c) 2016 Robert Giseburt
+ *
+ *  This file is part of the Motate Library.
+ *
+ *  This file ("the software") is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License, version 2 as published by the
+ *  Free Software Foundation. You should have received a copy of the GNU General Public
+ *  License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, you may use this file as part of a software library without
+ *  restriction. Specifically, if other files instantiate templates or use macros or
+ *  inline functions from this file, or you compile this file and link it with  other
+ *  files to produce an executable, this file does not by itself cause the resulting
+ *  executable to be covered by the GNU General Public License. This exception does not
+ *  however invalidate any other reasons why the executable file might be covered by the
+ *  GNU General Public License.
+ *
+ *  THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ *  WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ *  SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ *  OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. *
+ */
+
+#include "MotatePins.h"
+#include "MotateTimers.h"
+#include "MotateUART.h"
+
+// This makes the Motate:: prefix unnecessary.
+using namespace Motate;
+
+// Jumper TX to RX on the serial header: everything blasted out comes back in, and once a
+// second the bytes sent and received (and how many came back out of order) are reported.
+// The report itself loops back too, so each one shows up as a few bytes out of order.
+
+// Setup an led to blink and show that the board's working...
+OutputPin<kLED1_PinNumber> led1_pin;
+OutputPin<kLED2_PinNumber> led2_pin;
+
+const uint32_t kBaud = 1000000;
+const uint32_t kReportInterval = 1000; // ms
+
+BufferedUART<kSerial_RX, kSerial_TX, kSerial_RTS, kSerial_CTS, 1024, 1024> uart {kBaud, UARTMode::As8N1};
+
+uint32_t next_report = 0;
+uint32_t bytes_sent = 0;
+uint32_t bytes_received = 0;
+uint32_t bytes_out_of_order = 0;
+
+// The pattern is a running count, so what comes back can be checked as it's read
+uint8_t next_to_send = 0;
+uint8_t next_expected = 0;
+
+/****** Create file-global objects ******/
+
+// Write a number into the TX buffer, without pulling in printf
+void writeNumber(uint32_t value) {
+    char digits[11];
+    char *d = digits + sizeof(digits);
+    do {
+        *--d = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    uart.write(d, digits + sizeof(digits) - d, /*autoFlush =*/ true);
+}
+
+void report() {
+    uart.write("\nsent: ", 0, true);
+    writeNumber(bytes_sent);
+    uart.write(" B/s received: ", 0, true);
+    writeNumber(bytes_received);
+    uart.write(" B/s out of order: ", 0, true);
+    writeNumber(bytes_out_of_order);
+    uart.write("\n", 0, true);
+
+    bytes_sent = 0;
+    bytes_received = 0;
+    bytes_out_of_order = 0;
+}
+
+
+/****** Optional setup() function ******/
+
+void setup() {
+    uart.init();
+    uart.write("Startup...done.\n", 0, /*autoFlush =*/ true);
+
+    led1_pin = 0;
+    led2_pin = 1;
+
+    next_report = SysTickTimer.getValue() + kReportInterval;
+}
+
+/****** Main run loop() ******/
+
+
+void loop() {
+    // Fill whatever room there is in the TX buffer, in place
+    uint16_t length;
+    char *span = uart.reserve(length);
+    if (length) {
+        for (uint16_t i = 0; i < length; i++) {
+            span[i] = next_to_send++;
+        }
+        uart.commit(length);
+        bytes_sent += length;
+    }
+
+    // ... and check whatever came back, in place
+    span = uart.readSpan(length);
+    if (length) {
+        for (uint16_t i = 0; i < length; i++) {
+            uint8_t v = span[i];
+            if (v != next_expected) {
+                bytes_out_of_order++;
+            }
+            next_expected = v + 1;
+        }
+        uart.consume(length);
+        bytes_received += length;
+    }
+
+    if (SysTickTimer.getValue() >= next_report) {
+        next_report += kReportInterval;
+        led2_pin.toggle();
+        report();
+    }
+}
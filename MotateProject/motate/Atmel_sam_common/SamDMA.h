@@ -75,6 +75,7 @@ namespace Motate {
         using _hw::pdc;
         using _hw::startRxDoneInterrupts;
         using _hw::stopRxDoneInterrupts;
+        using _hw::startRxNextDoneInterrupts;
         using _hw::startTxDoneInterrupts;
         using _hw::stopTxDoneInterrupts;
         using _hw::inTxBufferEmptyInterrupt;
@@ -158,11 +159,20 @@ namespace Motate {
             }
             else if (include_next && doneReadingNext()) {
                 setNextRx(buffer, length);
+                // When the current buffer ends the PDC moves on to this one, and we want to know
+                // that (ENDRX) so another can be queued behind it.
+                if (handle_interrupts && (length != 0)) { startRxNextDoneInterrupts(); }
                 return true;
             }
             return false;
         }
 
+        // The PDC can't loop back on its own (only from an interrupt), so no circular receive.
+        // Use include_next ("ping-pong") transfers instead.
+        constexpr bool canRXRing() const { return false; };
+        bool startRXRing(void * const buffer, const uint32_t length, const uint32_t start_offset = 0) const { return false; };
+        void stopRXRing() const {};
+
 
         void disableTx() const
         {
@@ -172,6 +182,16 @@ namespace Motate {
         {
             pdc()->PERIPH_PTCR = PERIPH_PTCR_TXTEN;  // enable again
         };
+        // Hold the transfer where it is (for flow control). A transfer started while paused
+        // with setTx() also waits here until resumeTx().
+        void pauseTx() const
+        {
+            disableTx();
+        };
+        void resumeTx() const
+        {
+            enableTx();
+        };
         void setTx(void * const buffer, const uint32_t length) const
         {
             pdc()->PERIPH_TPR = (uint32_t)buffer;
@@ -252,16 +272,19 @@ namespace Motate {
         typedef char* buffer_t ;
 
         void startRxDoneInterrupts() const { usart()->US_IER = US_IER_RXBUFF; };
-        void stopRxDoneInterrupts() const { usart()->US_IDR = US_IDR_RXBUFF; };
+        void stopRxDoneInterrupts() const { usart()->US_IDR = US_IDR_RXBUFF | US_IDR_ENDRX; };
+        void startRxNextDoneInterrupts() const { usart()->US_IER = US_IER_ENDRX; };
         void startTxDoneInterrupts() const { usart()->US_IER = US_IER_TXBUFE; };
         void stopTxDoneInterrupts() const { usart()->US_IDR = US_IDR_TXBUFE; };
 
         bool inRxBufferEmptyInterrupt() const
         {
             // we check if the interupt is enabled
-            if (usart()->US_IMR & US_IMR_RXBUFF) {
+            auto US_IMR_hold = usart()->US_IMR;
+            if (US_IMR_hold & (US_IMR_RXBUFF | US_IMR_ENDRX)) {
                 // then we read the status register
-                return (usart()->US_CSR & US_CSR_RXBUFF);
+                // (ENDRX is the current buffer ending with a next one queued, RXBUFF is both ending)
+                return (usart()->US_CSR & US_IMR_hold & (US_CSR_RXBUFF | US_CSR_ENDRX));
             }
             return false;
         }
@@ -308,16 +331,19 @@ namespace Motate {
         };
 
         void startRxDoneInterrupts() const { uart()->UART_IER = UART_IER_RXBUFF; };
-        void stopRxDoneInterrupts() const { uart()->UART_IDR = UART_IDR_RXBUFF; };
+        void stopRxDoneInterrupts() const { uart()->UART_IDR = UART_IDR_RXBUFF | UART_IDR_ENDRX; };
+        void startRxNextDoneInterrupts() const { uart()->UART_IER = UART_IER_ENDRX; };
         void startTxDoneInterrupts() const { uart()->UART_IER = UART_IER_TXBUFE; };
         void stopTxDoneInterrupts() const { uart()->UART_IDR = UART_IDR_TXBUFE; };
 
         bool inRxBufferEmptyInterrupt() const
         {
             // we check if the interupt is enabled
-            if (uart()->UART_IMR & UART_IMR_RXBUFF) {
+            auto UART_IMR_hold = uart()->UART_IMR;
+            if (UART_IMR_hold & (UART_IMR_RXBUFF | UART_IMR_ENDRX)) {
                 // then we read the status register
-                return (uart()->UART_SR & UART_SR_RXBUFF);
+                // (ENDRX is the current buffer ending with a next one queued, RXBUFF is both ending)
+                return (uart()->UART_SR & UART_IMR_hold & (UART_SR_RXBUFF | UART_SR_ENDRX));
             }
             return false;
         }
@@ -557,6 +583,7 @@ namespace Motate {
         };
         void setRx(void * const buffer, const uint32_t length) const
         {
+            xdmaRxChannel()->XDMAC_CNDC = 0; // single block, in case we were in ring mode
             xdmaRxChannel()->XDMAC_CDA = (uint32_t)buffer;
             xdmaRxChannel()->XDMAC_CUBC = length;
         };
@@ -567,6 +594,7 @@ namespace Motate {
         };
         void flushRead() const
         {
+            disableRx(); // the count can't be changed out from under a running channel
             xdmaRxChannel()->XDMAC_CUBC = 0;
         };
         uint32_t leftToRead(bool include_next = false) const
@@ -609,13 +637,86 @@ namespace Motate {
                 }
                 return false;
             }
-            else if (include_next && doneReadingNext()) {
-                setNextRx(buffer, length);
-                return true;
-            }
+            // Single-block transfers only (for now), so there's no "next" to queue
             return false;
         };
 
+        // *** Circular receive
+        // The RX channel runs a linked list whose last descriptor points back at itself, so the
+        // XDMAC wraps around buffer forever without any help: no interrupts, no restarts, and
+        // nowhere for bytes to fall between transfers. The only state software needs is the
+        // write position, from getRXTransferPosition(). Nothing holds the DMA back, so unread
+        // data is overwritten a lap later.
+        //
+        // start_offset lets the first lap start part-way in (after data that's already there),
+        // using a first descriptor that then links to the looping one.
+        //
+        // Both descriptors are read by the XDMAC, so they live here and this object must outlive
+        // the ring. (If the data cache is ever turned on, the descriptors and the buffer will need
+        // to be in non-cacheable memory.)
+
+        // Linked-list descriptor, view 0 (next descriptor, microblock control, destination)
+        struct _RxRingDescriptor {
+            uint32_t mbr_nda;
+            uint32_t mbr_ubc;
+            uint32_t mbr_da;
+        };
+        mutable _RxRingDescriptor _rx_ring_descriptors[2] {}; // (a constexpr constructor has to initialize it)
+
+        // MBR_UBC fields (not in the CMSIS headers)
+        static constexpr uint32_t kXDMAC_UBC_UBLEN_Msk = 0x00FFFFFF;
+        static constexpr uint32_t kXDMAC_UBC_NDE = 1 << 24;   // fetch another descriptor after this one
+        static constexpr uint32_t kXDMAC_UBC_NDEN = 1 << 26;  // that descriptor updates the destination
+        static constexpr uint32_t kXDMAC_UBC_NVIEW_NDV0 = 0 << 27;
+
+        constexpr bool canRXRing() const { return true; };
+
+        bool startRXRing(void * const buffer, const uint32_t length, const uint32_t start_offset = 0) const
+        {
+            if ((length == 0) || (length > kXDMAC_UBC_UBLEN_Msk) || (start_offset >= length)) {
+                return false;
+            }
+
+            disableRx();
+            stopRxDoneInterrupts(); // every lap ends a block, and we don't want to hear about it
+
+            _RxRingDescriptor &first = _rx_ring_descriptors[0];
+            _RxRingDescriptor &loop = _rx_ring_descriptors[1];
+            const uint32_t ubc = kXDMAC_UBC_NVIEW_NDV0 | kXDMAC_UBC_NDE | kXDMAC_UBC_NDEN;
+
+            loop.mbr_nda = (uint32_t)&loop;
+            loop.mbr_ubc = ubc | length;
+            loop.mbr_da = (uint32_t)buffer;
+
+            first.mbr_nda = (uint32_t)&loop;
+            first.mbr_ubc = ubc | (length - start_offset);
+            first.mbr_da = (uint32_t)buffer + start_offset;
+
+            // The descriptors have to be in memory before the XDMAC goes looking
+            __DSB();
+
+            xdmaRxChannel()->XDMAC_CUBC = 0;
+            xdmaRxChannel()->XDMAC_CBC = 0;
+            xdmaRxChannel()->XDMAC_CDS_MSP = 0;
+            xdmaRxChannel()->XDMAC_CNDA = (uint32_t)&first;
+            xdmaRxChannel()->XDMAC_CNDC =
+                XDMAC_CNDC_NDVIEW_NDV0 |
+                XDMAC_CNDC_NDE_DSCR_FETCH_EN |
+                XDMAC_CNDC_NDSUP_SRC_PARAMS_UNCHANGED | // the source is always the peripheral
+                XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED
+            ;
+
+            enableRx();
+            return true;
+        };
+
+        void stopRXRing() const
+        {
+            disableRx();
+            xdmaRxChannel()->XDMAC_CNDC = 0;
+            xdmaRxChannel()->XDMAC_CUBC = 0;
+        };
+
 
         void disableTx() const
         {
@@ -625,6 +726,20 @@ namespace Motate {
         {
             xdma()->XDMAC_GE = XDMAC_GIE_IE0 << xdmaTxChannelNumber();
         };
+        // Hold the transfer where it is (for flow control). Disabling the channel would end the
+        // transfer, so we suspend it instead. A transfer loaded with setTx() while paused hasn't
+        // been enabled yet, so resumeTx() starts it.
+        void pauseTx() const
+        {
+            xdma()->XDMAC_GRWS = XDMAC_GRWS_RWS0 << xdmaTxChannelNumber();
+        };
+        void resumeTx() const
+        {
+            xdma()->XDMAC_GRWR = XDMAC_GRWR_RWR0 << xdmaTxChannelNumber();
+            if (!(xdma()->XDMAC_GS & (XDMAC_GS_ST0 << xdmaTxChannelNumber())) && !doneWriting()) {
+                enableTx();
+            }
+        };
         void setTx(void * const buffer, const uint32_t length) const
         {
             xdmaTxChannel()->XDMAC_CSA = (uint32_t)buffer;
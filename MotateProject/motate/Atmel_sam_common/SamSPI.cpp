@@ -31,9 +31,9 @@
 #include "MotateSPI.h"
 
 namespace Motate {
-    template<> std::function<void(uint16_t)> _SPIHardware<0>::_spiInterruptHandler {};
+    template<> SPICallback<void(uint16_t)> _SPIHardware<0>::_spiInterruptHandler {};
 #if defined(HAS_SPI1)
-    template<> std::function<void(uint16_t)> _SPIHardware<1>::_spiInterruptHandler {};
+    template<> SPICallback<void(uint16_t)> _SPIHardware<1>::_spiInterruptHandler {};
 #endif // HAS_SPI1
 }
 
@@ -115,7 +115,7 @@ namespace Motate {
 
         typedef _SPIHardware<spiPeripheralNumber> this_type_t;
 
-        static std::function<void(uint16_t)> _spiInterruptHandler;
+        static SPICallback<void(uint16_t)> _spiInterruptHandler;
 
         void init() {
 //            static bool inited = false;
@@ -366,8 +366,8 @@ namespace Motate {
 #endif // temporarily removed read/write/transfer
 
 
-        void setInterruptHandler(std::function<void(uint16_t)> &&handler) {
-            _spiInterruptHandler = std::move(handler);
+        void setInterruptHandler(const SPICallback<void(uint16_t)> &handler) {
+            _spiInterruptHandler = handler;
         }
 
         static uint16_t getInterruptCause() {
@@ -458,6 +458,20 @@ namespace Motate {
             }
         };
 
+        // Hold off (or allow) the SPI interrupt, to update state it shares with non-interrupt code
+        void _setInterruptMasked(bool masked) {
+            if (masked) {
+                NVIC_DisableIRQ(spiIRQ());
+            } else {
+                NVIC_EnableIRQ(spiIRQ());
+            }
+        };
+
+        // Have the SPI interrupt run (as soon as it isn't masked and nothing more important is)
+        void _setInterruptPending() {
+            NVIC_SetPendingIRQ(spiIRQ());
+        };
+
 #ifdef CAN_SPI_PDC_DMA
         void _enableOnTXTransferDoneInterrupt() {
             spi()->SPI_IER = SPI_IER_TXBUFE;
@@ -519,31 +533,45 @@ namespace Motate {
                 spi()->SPI_PTCR = PTCR_prep;
                 return true;
             }
-//            else if ((spi()->SPI_RNCR == 0) && (spi()->SPI_TNCR == 0)) {
-//                // setup next PDC transfer
-//                if (rx_buffer != nullptr) {
-//                    spi()->SPI_RNPR = (uint32_t)rx_buffer;
-//                    spi()->SPI_RNCR = size;
-//                } else {
-//                    spi()->SPI_RNPR = 0;
-//                    spi()->SPI_RNCR = 0;
-//                }
-//                if (tx_buffer != nullptr) {
-//                    spi()->SPI_TNPR = (uint32_t)tx_buffer;
-//                    spi()->SPI_TNCR = size;
-//                } else {
-//                    spi()->SPI_TNPR = 0;
-//                    spi()->SPI_TNCR = 0;
-//                    // HMM, how to handle _toss_next_read here?
-//                }
-//
-//                // current transfer should already be enabled...
-//                return true;
-//            }
 
             // We didn't set anything up...
             return false;
         }
+
+        static constexpr bool canChainTransfers() { return true; };
+
+        // Queue a transfer in the PDC "next" registers, to start the moment the running one ends, on
+        // the same chip select and with no interrupt in between. Both the running and the queued
+        // transfer must send and receive, since the receive side is what tells us they're done,
+        // and the done interrupt (RXBUFF) won't fire until both have finished.
+        // Returns false if nothing was queued: there's already a next transfer, or the running one
+        // has finished and the caller should start this one normally when it's been handled.
+        bool startNextTransfer(uint8_t *tx_buffer, uint8_t *rx_buffer, uint16_t size) {
+            if ((tx_buffer == nullptr) || (rx_buffer == nullptr)) {
+                return false;
+            }
+            if ((spi()->SPI_RNCR != 0) || (spi()->SPI_TNCR != 0)) {
+                return false;
+            }
+            if ((spi()->SPI_RCR == 0) && (spi()->SPI_TCR == 0)) {
+                return false;
+            }
+
+            // Receive first: if the running transfer ends between these, the PDC loads whatever
+            // counter is nonzero straight into the current registers, and the receive side must
+            // be ready before the first word goes out.
+            spi()->SPI_RNPR = (uint32_t)rx_buffer;
+            spi()->SPI_RNCR = size;
+            spi()->SPI_TNPR = (uint32_t)tx_buffer;
+            spi()->SPI_TNCR = size;
+
+            // current transfer should already be enabled...
+            return true;
+        }
+#else
+        static constexpr bool canChainTransfers() { return false; };
+
+        bool startNextTransfer(uint8_t *tx_buffer, uint8_t *rx_buffer, uint16_t size) { return false; };
 #endif // CAN_SPI_PDC_DMA
         // abort transfer of message
 
@@ -102,6 +102,49 @@ namespace Motate {
         REMOTE_LOOPBACK     = 0x3 << US_MR_CHMODE_Pos
     };
 
+    // USART baud rate generator settings.
+    // baud = MCK / (8 * (2 - OVER) * (CD + FP/8)), so in eighths the divisor is MCK / ((2 - OVER) * baud).
+    // We try both 16x (OVER = 0) and 8x oversampling and keep the closer one, preferring 16x (it's
+    // more tolerant of noise and clock skew) on a tie. 8x is what makes the multi-Mbaud rates usable.
+    // Everything here is constexpr, so with a constant clock and baud it all folds away.
+    struct USARTBaudSetting {
+        uint32_t divisor_eighths;   // CD * 8 + FP
+        bool over;                  // true for 8x oversampling
+
+        static constexpr uint32_t kMinDivisorEighths = 1 << 3;                      // CD = 1
+        static constexpr uint32_t kMaxDivisorEighths = ((US_BRGR_CD_Msk >> US_BRGR_CD_Pos) << 3) | 0x7;
+
+        constexpr uint32_t cd() const { return divisor_eighths >> 3; };
+        constexpr uint32_t fp() const { return divisor_eighths & 0x7; };
+
+        // The baud that this setting actually gets, given the peripheral clock
+        constexpr uint32_t baud(const uint32_t mck) const {
+            const uint32_t divisor = (over ? 1 : 2) * divisor_eighths;
+            return (mck + divisor/2) / divisor;
+        };
+
+        static constexpr USARTBaudSetting _forOversampling(const uint32_t mck, const uint32_t baud, const bool over) {
+            const uint32_t divisor = (over ? 1 : 2) * baud;
+            uint32_t divisor_eighths = (mck + divisor/2) / divisor;
+            if (divisor_eighths < kMinDivisorEighths) {
+                divisor_eighths = kMinDivisorEighths;
+            } else if (divisor_eighths > kMaxDivisorEighths) {
+                divisor_eighths = kMaxDivisorEighths;
+            }
+            return USARTBaudSetting {divisor_eighths, over};
+        };
+
+        static constexpr uint32_t _error(const uint32_t mck, const uint32_t baud, const USARTBaudSetting setting) {
+            return (setting.baud(mck) > baud) ? (setting.baud(mck) - baud) : (baud - setting.baud(mck));
+        };
+
+        static constexpr USARTBaudSetting compute(const uint32_t mck, const uint32_t baud) {
+            const USARTBaudSetting x16 = _forOversampling(mck, baud, false);
+            const USARTBaudSetting x8 = _forOversampling(mck, baud, true);
+            return (_error(mck, baud, x8) < _error(mck, baud, x16)) ? x8 : x16;
+        };
+    };
+
     // USART peripherals
     template<uint8_t uartPeripheralNumber>
     struct _USARTHardware {
@@ -173,19 +216,21 @@ namespace Motate {
             disable();
 
             // Oversampling is either 8 or 16. Depending on the baud, we may need to select 8x in
-            // order to get the error low.
+            // order to get the error low. The fractional part gets the rest of the way there.
+            setBaud(baud);
 
-            // For all of the speeds up to and including 230400, 16x multiplier worked fine in testing.
-            // All yielded a <1% error in final baud.
-            usart()->US_BRGR = US_BRGR_CD((((SamCommon::getPeripheralClockFreq() * 10) / (16 * baud)) + 5)/10) | US_BRGR_FP(0);
-            usart()->US_MR &= ~US_MR_OVER;
 
-
-            if (options & UARTMode::RTSCTSFlowControl) {
+            if (options & UARTMode::RS485) {
+                // RTS is the driver enable (see setRS485Turnaround())
+                usart()->US_MR = (usart()->US_MR & ~US_MR_USART_MODE_Msk) | US_MR_USART_MODE_RS485;
+            } else if (options & UARTMode::RTSCTSFlowControl) {
                 usart()->US_MR = (usart()->US_MR & ~US_MR_USART_MODE_Msk) | US_MR_USART_MODE_HW_HANDSHAKING;
             } else {
                 usart()->US_MR = (usart()->US_MR & ~US_MR_USART_MODE_Msk) | US_MR_USART_MODE_NORMAL;
             }
+            if (!(options & UARTMode::RS485)) {
+                usart()->US_TTGR = 0; // outside of RS-485 it's only a gap between characters
+            }
 
             if (options & UARTMode::TwoStopBits) {
                 usart()->US_MR = (usart()->US_MR & ~(US_MR_NBSTOP_Msk)) | US_MR_NBSTOP_2_BIT;
@@ -198,7 +243,9 @@ namespace Motate {
             } else {
                 usart()->US_MR = (usart()->US_MR & ~(US_MR_MODE9|US_MR_CHRL_Msk)) | static_cast<uint32_t>(CHRL_t::CH_8_BIT);
             }
-            if (options & UARTMode::EvenParity) {
+            if (options & UARTMode::Multidrop) {
+                usart()->US_MR = (usart()->US_MR & ~(US_MR_PAR_Msk)) | US_MR_PAR_MULTIDROP;
+            } else if (options & UARTMode::EvenParity) {
                 usart()->US_MR = (usart()->US_MR & ~(US_MR_PAR_Msk)) | US_MR_PAR_EVEN;
             } else if (options & UARTMode::OddParity) {
                 usart()->US_MR = (usart()->US_MR & ~(US_MR_PAR_Msk)) | US_MR_PAR_ODD;
@@ -211,6 +258,32 @@ namespace Motate {
 
         };
 
+        // Returns the baud actually achieved. Call with the USART disabled (setOptions() does).
+        uint32_t setBaud(const uint32_t baud) {
+            const uint32_t mck = SamCommon::getPeripheralClockFreq();
+            const USARTBaudSetting setting = USARTBaudSetting::compute(mck, baud);
+
+            usart()->US_BRGR = US_BRGR_CD(setting.cd()) | US_BRGR_FP(setting.fp());
+            if (setting.over) {
+                usart()->US_MR |= US_MR_OVER;
+            } else {
+                usart()->US_MR &= ~US_MR_OVER;
+            }
+            return setting.baud(mck);
+        };
+
+        // The baud the hardware is actually set to
+        uint32_t getBaud() {
+            const USARTBaudSetting setting {
+                ((usart()->US_BRGR & US_BRGR_CD_Msk) >> US_BRGR_CD_Pos) << 3 | ((usart()->US_BRGR & US_BRGR_FP_Msk) >> US_BRGR_FP_Pos),
+                (usart()->US_MR & US_MR_OVER) != 0
+            };
+            if (setting.cd() == 0) {
+                return 0; // the baud rate generator is off
+            }
+            return setting.baud(SamCommon::getPeripheralClockFreq());
+        };
+
         void setInterrupts(const uint16_t interrupts) {
             if (interrupts != UARTInterrupt::Off) {
 
@@ -265,6 +338,16 @@ namespace Motate {
             _uartInterruptHandler = std::move(handler);
         }
 
+        // Hold off (or let through) just this peripheral's interrupt, for short
+        // sections that share state with the interrupt handler.
+        void _setInterruptMasked(bool masked) {
+            if (masked) {
+                NVIC_DisableIRQ(usartIRQ());
+            } else {
+                NVIC_EnableIRQ(usartIRQ());
+            }
+        };
+
         void _setInterruptTxReady(bool value) {
             if (value) {
                 usart()->US_IER = US_IER_TXRDY;
@@ -289,6 +372,74 @@ namespace Motate {
             }
         };
 
+        // RS-485: how many bit periods RTS (driver enable) stays up after the last stop bit.
+        // The hardware also leaves this gap between characters, so keep it small.
+        constexpr bool canRS485() { return true; };
+        bool setRS485Turnaround(const uint8_t bit_times) {
+            usart()->US_TTGR = US_TTGR_TG(bit_times);
+            return true;
+        };
+
+        // Receiver timeout: interrupt (OnRxIdle) once the line has been idle for bit_times bit
+        // periods after a character. The counter waits for a character before it starts, so
+        // it only fires once per burst. 0 turns it off.
+        bool setRxIdleTimeout(uint32_t bit_times) {
+            constexpr uint32_t max_bit_times = US_RTOR_TO_Msk >> US_RTOR_TO_Pos;
+            if (bit_times > max_bit_times) {
+                bit_times = max_bit_times;
+            }
+            usart()->US_RTOR = US_RTOR_TO(bit_times);
+            if (bit_times) {
+                usart()->US_CR = US_CR_STTTO;
+                usart()->US_IER = US_IER_TIMEOUT;
+            } else {
+                usart()->US_IDR = US_IDR_TIMEOUT;
+            }
+            return true;
+        };
+
+        // Clears the timeout and waits for the next character to start counting again
+        void _restartRxIdleTimeout() {
+            usart()->US_CR = US_CR_STTTO;
+        };
+
+        void _setInterruptRxError(bool value) {
+            if (value) {
+                usart()->US_IER = US_IER_OVRE | US_IER_FRAME | US_IER_PARE;
+            } else {
+                usart()->US_IDR = US_IDR_OVRE | US_IDR_FRAME | US_IDR_PARE;
+            }
+        };
+
+        // The error flags stay set until this. The receiver (and any DMA) keeps going.
+        void _clearRxErrors() {
+            usart()->US_CR = US_CR_RSTSTA;
+        };
+
+        void _setInterruptRxOverrun(bool value) {
+            if (value) {
+                usart()->US_IER = US_IER_OVRE;
+            } else {
+                usart()->US_IDR = US_IDR_OVRE;
+            }
+        };
+
+        // Multidrop: the next character written goes out as an address (SENDA). The transmitter
+        // must be free (no DMA writing), or this returns false.
+        constexpr bool canMultidrop() { return true; };
+        bool writeAddress(const uint8_t address) {
+            if (!(usart()->US_CSR & US_CSR_TXRDY) || !dma()->doneWriting()) {
+                return false;
+            }
+            usart()->US_CR = US_CR_SENDA;
+            usart()->US_THR = US_THR_TXCHR(address);
+            return true;
+        };
+        // The last character received (it stays there after the DMA reads it)
+        uint8_t _readAddress() {
+            return usart()->US_RHR & 0xFF;
+        };
+
         void setInterruptTxTransferDone(bool value) {
             if (value) {
                 dma()->startTxDoneInterrupts();
@@ -334,10 +485,31 @@ namespace Motate {
             {
                 status |= UARTInterrupt::OnRxTransferDone;
             }
+            if ((US_IMR_hold & US_IMR_OVRE) && (US_CSR_hold & US_CSR_OVRE))
+            {
+                status |= UARTInterrupt::OnRxOverrun;
+            }
+            if ((US_IMR_hold & US_IMR_FRAME) && (US_CSR_hold & US_CSR_FRAME))
+            {
+                status |= UARTInterrupt::OnRxFramingError;
+            }
+            if ((US_IMR_hold & US_IMR_PARE) && (US_CSR_hold & US_CSR_PARE))
+            {
+                // In multidrop mode, the "parity error" is the address bit
+                if ((usart()->US_MR & US_MR_PAR_Msk) == US_MR_PAR_MULTIDROP) {
+                    status |= UARTInterrupt::OnRxAddress;
+                } else {
+                    status |= UARTInterrupt::OnRxParityError;
+                }
+            }
             if ((US_IMR_hold & US_IMR_CTSIC) && (US_CSR_hold & US_CSR_CTSIC))
             {
                 status |= UARTInterrupt::OnCTSChanged;
             }
+            if ((US_IMR_hold & US_IMR_TIMEOUT) && (US_CSR_hold & US_CSR_TIMEOUT))
+            {
+                status |= UARTInterrupt::OnRxIdle;
+            }
             return status;
         }
 
@@ -380,8 +552,21 @@ namespace Motate {
 
 
         // ***** Handle Tranfers
-        bool startRXTransfer(char *buffer, const uint16_t length) {
-            return dma()->startRXTransfer(buffer, length, true);
+        bool startRXTransfer(char *buffer, const uint16_t length, bool include_next = false) {
+            return dma()->startRXTransfer(buffer, length, true, include_next);
+        };
+
+        bool isRXTransferActive() {
+            return !dma()->doneReading();
+        };
+
+        // Circular receive (see DMA_XDMAC::startRXRing()). Only with an XDMAC.
+        constexpr bool canRXRing() { return dma()->canRXRing(); };
+        bool startRXRing(char *buffer, const uint32_t length, const uint32_t start_offset = 0) {
+            return dma()->startRXRing(buffer, length, start_offset);
+        };
+        void stopRXRing() {
+            dma()->stopRXRing();
         };
 
         char* getRXTransferPosition() {
@@ -390,22 +575,34 @@ namespace Motate {
 
         bool _tx_paused = false;
         bool startTXTransfer(char *buffer, const uint16_t length) {
+            if (_tx_paused) {
+                // Load it, but leave it for resumeTX() to start
+                if (!dma()->doneWriting()) {
+                    return false;
+                }
+                dma()->stopTxDoneInterrupts();
+                dma()->setTx(buffer, length);
+                if (length == 0) {
+                    return false;
+                }
+                dma()->startTxDoneInterrupts();
+                return true;
+            }
             return dma()->startTXTransfer(buffer, length, true);
         };
 
         char* getTXTransferPosition() {
-            if (_tx_paused) { return false; }
             return dma()->getTXTransferPosition();
         };
 
         void pauseTX() {
             _tx_paused = true;
-            dma()->disableTx();
+            dma()->pauseTx();
         };
 
         void resumeTX() {
             _tx_paused = false;
-            dma()->enableTx();
+            dma()->resumeTx();
         };
     };
 
@@ -484,10 +681,8 @@ namespace Motate {
         void setOptions(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
             disable();
 
-            // Oversampling is either 8 or 16. Depending on the baud, we may need to select 8x in
-            // order to get the error low.
-
-            uart()->UART_BRGR = UART_BRGR_CD(SamCommon::getPeripheralClockFreq() / (16 * baud));
+            // The UARTs only have 16x oversampling and no fractional part, so just round CD.
+            uart()->UART_BRGR = UART_BRGR_CD((SamCommon::getPeripheralClockFreq() + 8 * baud) / (16 * baud));
 
             // No hardware flow control
             // if (options & UARTMode::RTSCTSFlowControl) {
@@ -517,6 +712,15 @@ namespace Motate {
 
         };
 
+        // The baud the hardware is actually set to
+        uint32_t getBaud() {
+            const uint32_t cd = (uart()->UART_BRGR & UART_BRGR_CD_Msk) >> UART_BRGR_CD_Pos;
+            if (cd == 0) {
+                return 0; // the baud rate generator is off
+            }
+            return (SamCommon::getPeripheralClockFreq() + 8 * cd) / (16 * cd);
+        };
+
         void setInterrupts(const uint16_t interrupts) {
             if (interrupts != UARTInterrupt::Off) {
 
@@ -561,6 +765,16 @@ namespace Motate {
             _uartInterruptHandler = std::move(handler);
         }
 
+        // Hold off (or let through) just this peripheral's interrupt, for short
+        // sections that share state with the interrupt handler.
+        void _setInterruptMasked(bool masked) {
+            if (masked) {
+                NVIC_DisableIRQ(uartIRQ());
+            } else {
+                NVIC_EnableIRQ(uartIRQ());
+            }
+        };
+
         void _setInterruptTxReady(bool value) {
             if (value) {
                 uart()->UART_IER = UART_IER_TXRDY;
@@ -583,6 +797,40 @@ namespace Motate {
             }
         };
 
+        // The UARTs don't have RTS, so no RS-485
+        constexpr bool canRS485() { return false; };
+        bool setRS485Turnaround(const uint8_t bit_times) { return false; };
+
+        // The UARTs don't have a receiver timeout
+        bool setRxIdleTimeout(uint32_t bit_times) { return bit_times == 0; };
+        void _restartRxIdleTimeout() {};
+
+        void _setInterruptRxError(bool value) {
+            if (value) {
+                uart()->UART_IER = UART_IER_OVRE | UART_IER_FRAME | UART_IER_PARE;
+            } else {
+                uart()->UART_IDR = UART_IDR_OVRE | UART_IDR_FRAME | UART_IDR_PARE;
+            }
+        };
+
+        // The error flags stay set until this. The receiver (and any DMA) keeps going.
+        void _clearRxErrors() {
+            uart()->UART_CR = UART_CR_RSTSTA;
+        };
+
+        void _setInterruptRxOverrun(bool value) {
+            if (value) {
+                uart()->UART_IER = UART_IER_OVRE;
+            } else {
+                uart()->UART_IDR = UART_IDR_OVRE;
+            }
+        };
+
+        // The UARTs have no multidrop mode
+        constexpr bool canMultidrop() { return false; };
+        bool writeAddress(const uint8_t address) { return false; };
+        uint8_t _readAddress() { return 0; };
+
         void setInterruptTxTransferDone(bool value) {
             if (value) {
                 dma()->startTxDoneInterrupts();
@@ -628,6 +876,18 @@ namespace Motate {
             {
                 status |= UARTInterrupt::OnRxTransferDone;
             }
+            if ((UART_IMR_hold & UART_IMR_OVRE) && (UART_SR_hold & UART_SR_OVRE))
+            {
+                status |= UARTInterrupt::OnRxOverrun;
+            }
+            if ((UART_IMR_hold & UART_IMR_FRAME) && (UART_SR_hold & UART_SR_FRAME))
+            {
+                status |= UARTInterrupt::OnRxFramingError;
+            }
+            if ((UART_IMR_hold & UART_IMR_PARE) && (UART_SR_hold & UART_SR_PARE))
+            {
+                status |= UARTInterrupt::OnRxParityError;
+            }
             return status;
         }
 
@@ -666,8 +926,21 @@ namespace Motate {
 
 
         // ***** Handle Tranfers
-        bool startRXTransfer(char *buffer, const uint16_t length) {
-            return dma()->startRXTransfer(buffer, length, true);
+        bool startRXTransfer(char *buffer, const uint16_t length, bool include_next = false) {
+            return dma()->startRXTransfer(buffer, length, true, include_next);
+        };
+
+        bool isRXTransferActive() {
+            return !dma()->doneReading();
+        };
+
+        // Circular receive (see DMA_XDMAC::startRXRing()). Only with an XDMAC.
+        constexpr bool canRXRing() { return dma()->canRXRing(); };
+        bool startRXRing(char *buffer, const uint32_t length, const uint32_t start_offset = 0) {
+            return dma()->startRXRing(buffer, length, start_offset);
+        };
+        void stopRXRing() {
+            dma()->stopRXRing();
         };
 
         char* getRXTransferPosition() {
@@ -676,7 +949,19 @@ namespace Motate {
 
         bool _tx_paused = false;
         bool startTXTransfer(char *buffer, const uint16_t length) {
-            if (_tx_paused) { return false; }
+            if (_tx_paused) {
+                // Load it, but leave it for resumeTX() to start
+                if (!dma()->doneWriting()) {
+                    return false;
+                }
+                dma()->stopTxDoneInterrupts();
+                dma()->setTx(buffer, length);
+                if (length == 0) {
+                    return false;
+                }
+                dma()->startTxDoneInterrupts();
+                return true;
+            }
             return dma()->startTXTransfer(buffer, length, true);
         };
 
@@ -686,12 +971,12 @@ namespace Motate {
 
         void pauseTX() {
             _tx_paused = true;
-            dma()->disableTx();
+            dma()->pauseTx();
         };
 
         void resumeTX() {
             _tx_paused = false;
-            dma()->enableTx();
+            dma()->resumeTx();
         };
 };
 
@@ -717,284 +1002,8 @@ namespace Motate {
         return IsUARTCTSPin<ctsPinNumber>() && (UARTCTSPin<ctsPinNumber>::uartNum == UARTRxPin<rxPinNumber>::uartNum);
     }
 
-//    template<uint8_t uartPeripheralNumber>
-//    struct _UARTHardwareProxy {
-//    };
-
-
-//    template<uint8_t uartPeripheralNumber, pin_number rtsPinNumber, pin_number ctsPinNumber, typename rxBufferClass, typename txBufferClass>
-//    struct _BufferedUARTHardware : _UARTHardware<uartPeripheralNumber> {
-//        rxBufferClass rxBuffer;
-//        txBufferClass txBuffer;
-//
-//        OutputPin<rtsPinNumber> rtsPin;
-//        IRQPin<ctsPinNumber> ctsPin;
-//
-//        uint32_t txDelayAfterResume = 3;
-//        uint32_t txDelayUntilTime   = 0;
-//
-//        bool _rtsCtsFlowControl    = false;
-//        bool _xonXoffFlowControl   = false;
-//        volatile bool _xonXoffCanSend       = true;
-//        volatile char _xonXoffStartStop     = kUARTXOn;
-//        volatile bool _xonXoffStartStopSent = true;
-//
-//        typedef _UARTHardware<uartPeripheralNumber> parent;
-//
-//        _BufferedUARTHardware() {
-//        };
-//
-//        void init() {
-//            parent::init();
-//            parent::setInterrupts(UARTInterrupt::OnRxReady | UARTInterrupt::PriorityLowest);
-//            _UARTHardwareProxy<uartPeripheralNumber>::uartInterruptHandler = [&](uint16_t interruptCause) { // use a closure
-//                uartInterruptHandler(interruptCause);
-//            };
-//        };
-//
-//        void setOptions(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
-//            parent::setOptions(baud, options, fromConstructor);
-//
-//            if (options & UARTMode::RTSCTSFlowControl && IsIRQPin<ctsPinNumber>() && !rtsPin.isNull()) {
-//                _rtsCtsFlowControl = true;
-////                parent::setInterruptTxReady(!canSend());
-//                ctsPin.setInterrupts(kPinInterruptOnChange);
-//            } else {
-//                _rtsCtsFlowControl = false;
-//            }
-////            if (options & UARTMode::XonXoffFlowControl) {
-////                _xonXoffFlowControl = true;
-////            } else {
-////                _xonXoffFlowControl = false;
-////                _xonXoffStartStopSent = true;
-////            }
-//        }
-//
-////        void stopRx() {
-////            if (_rtsCtsFlowControl) {
-////                rtsPin = true;
-////            }
-////            if (_xonXoffFlowControl && _xonXoffStartStop != kUARTXOff) {
-////                _xonXoffStartStop = kUARTXOff;
-////                _xonXoffStartStopSent = false;
-////                parent::setInterruptTxReady(true);
-////            }
-////        };
-////
-////        void startRx() {
-////            if (_rtsCtsFlowControl) {
-////                rtsPin = false;
-////            }
-////            if (_xonXoffFlowControl && _xonXoffStartStop != kUARTXOn) {
-////                _xonXoffStartStop = kUARTXOn;
-////                _xonXoffStartStopSent = false;
-////                parent::setInterruptTxReady(true);
-////            }
-////        };
-//
-////        bool canSend() {
-////            if (_rtsCtsFlowControl) {
-////                return !ctsPin;
-////            }
-////            if (_xonXoffFlowControl) {
-////                return _xonXoffCanSend;
-////            }
-////            return true;
-////        };
-//
-//        void setTxDelayAfterResume(uint32_t newDelay) { txDelayAfterResume = newDelay; };
-//
-//        int16_t readByte() {
-//            return rxBuffer.read();
-//        };
-//
-//        int16_t writeByte(const uint8_t data) {
-//            int16_t ret = txBuffer.write(data);
-//            return ret;
-//        };
-//
-//        void uartInterruptHandler(uint16_t interruptCause) {
-////            if ((interruptCause & (UARTInterrupt::OnTxReady /*| UARTInterrupt::OnTxDone*/))) {
-////                if (txDelayUntilTime && SysTickTimer.getValue() < txDelayUntilTime)
-////                    return;
-////                txDelayUntilTime = 0;
-////                if (_xonXoffFlowControl) {
-////                    if (_xonXoffStartStopSent == false) {
-////                        parent::writeByte(_xonXoffStartStop);
-////                        _xonXoffStartStopSent = true;
-////                        return;
-////                    }
-////                }
-////                int16_t value = txBuffer.read();
-////                if (value >= 0) {
-////                    parent::writeByte(value);
-////                }
-////            }
-////            if (txBuffer.isEmpty() || txBuffer.isLocked()) {
-////                // This is tricky: If it's write locked, we have to bail, and SHUT OFF TxReady interrupts.
-////                // On the ARM, it won't return to the main code as long as there's a pending interrupt,
-////                // and the txReady interrupt will continue to fire, causing deadlock.
-////                parent::setInterruptTxReady(false);
-////            }
-////
-////            if ((interruptCause & UARTInterrupt::OnRxReady) && !rxBuffer.isFull()) {
-////                int16_t value = parent::readByte();
-////                if (_xonXoffFlowControl) {
-////                    if (value == kUARTXOn) {
-////                        _xonXoffCanSend = true;
-////                        return;
-////                    } else if (value == kUARTXOff) {
-////                        _xonXoffCanSend = false;
-////                        return;
-////                    }
-////                }
-////                // We don't double check to ensure value is not -1 -- should we?
-////                rxBuffer.write(value);
-////                if (rxBuffer.available() < 4) {
-////                    stopRx();
-////                }
-////            }
-//        };
-//
-////        void pinChangeInterrupt() {
-////            txDelayUntilTime = SysTickTimer.getValue() + txDelayAfterResume;
-////            parent::setInterruptTxReady(canSend());
-////        };
-//
-//        void flush() {
-//            // Wait for the buffer to be empty...
-//            while(!txBuffer.isEmpty());
-//        };
-//    };
-
-
-
-//    template<pin_number rxPinNumber, pin_number txPinNumber, pin_number rtsPinNumber = -1, pin_number ctsPinNumber = -1, typename rxBufferClass = Buffer<128>, typename txBufferClass = rxBufferClass>
-//    struct BufferedUART {
-//        UARTRxPin<rxPinNumber> rxPin;
-//        UARTTxPin<txPinNumber> txPin;
-//
-//
-//        _BufferedUARTHardware< UARTGetHardware<rxPinNumber, txPinNumber>::uartPeripheralNum, rtsPinNumber, ctsPinNumber, rxBufferClass, txBufferClass > hardware;
-//
-//
-//        const uint8_t uartPeripheralNum() { return hardware.uartPeripheralNum; };
-//
-//        BufferedUART(const uint32_t baud = 115200, const uint16_t options = UARTMode::As8N1) {
-//            hardware.init();
-//            init(baud, options, /*fromConstructor =*/ true);
-//        };
-//
-//        void init(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
-//            setOptions(baud, options, fromConstructor);
-//        };
-//
-//        void setOptions(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
-//            hardware.setOptions(baud, options, fromConstructor);
-//        };
-//
-//
-//
-//        int16_t readByte() {
-//            return hardware.readByte();
-//        };
-//
-//        // WARNING: Currently only reads in bytes. For more-that-byte size data, we'll need another call.
-//        int16_t read(const uint8_t *buffer, const uint16_t length) {
-//            int16_t total_read = 0;
-//            int16_t to_read = length;
-//            const uint8_t *read_ptr = buffer;
-//
-//            // BLOCKING!!
-//            while (to_read > 0) {
-//                int16_t ret = hardware.readByte();
-//
-//                if (ret >= 0) {
-//                    *read_ptr++ = ret;
-//                    total_read++;
-//                    to_read--;
-//                }
-//            };
-//
-//            return total_read;
-//        };
-//
-//        int16_t writeByte(uint8_t data) {
-//            return hardware.writeByte(data);
-//        };
-//
-//        void flush() {
-//            hardware.flush();
-//        };
-//
-//        // WARNING: Currently only writes in bytes. For more-that-byte size data, we'll need another call.
-//        int16_t write(const char* data, const uint16_t length = 0, bool autoFlush = false) {
-//            int16_t total_written = 0;
-//            const char* out_ptr = data;
-//            int16_t to_write = length;
-//
-//            if (length==0 && *out_ptr==0) {
-//                return 0;
-//            }
-//
-//            do {
-//                int16_t ret = hardware.writeByte(*out_ptr);
-//
-//                if (ret > 0) {
-//                    out_ptr++;
-//                    total_written++;
-//                    to_write--;
-//
-//                    if (length==0 && *out_ptr==0) {
-//                        break;
-//                    }
-//                } else if (autoFlush) {
-//                    flush();
-//                } else {
-//                    break;
-//                }
-//            } while (to_write);
-//
-//            if (autoFlush && total_written > 0)
-//                flush();
-//
-//            return total_written;
-//        };
-//
-//        template<uint16_t _size>
-//        int16_t write(Motate::Buffer<_size> &data, const uint16_t length = 0, bool autoFlush = false) {
-//            int16_t total_written = 0;
-//            int16_t to_write = length;
-//
-//            do {
-//                int16_t value = data.peek();
-//                if (value < 0) // no more data
-//                    break;
-//
-//                int16_t ret = hardware.writeByte(value);
-//                if (ret > 0) {
-//                    data.pop();
-//                    to_write--;
-//                } else if (autoFlush) {
-//                    flush();
-//                } else {
-//                    break;
-//                }
-//            } while (to_write != 0);
-//
-//            if (autoFlush && total_written > 0)
-//                flush();
-//
-//            return total_written;
-//        };
-//
-//        void pinChangeInterrupt() {
-//            hardware.pinChangeInterrupt();
-//        };
-//
-//        //	// Placeholder for user code.
-//        //	static void interrupt() __attribute__ ((weak));
-//    };
+    // BufferedUART (a UART with DMA-driven RXBuffer and TXBuffer) is in MotateUART.h
+
 }
 
 #endif /* end of include guard: SAM4XUART_H_ONCE */
@@ -426,7 +426,7 @@ namespace Motate {
             return total_written;
         };
 
-    	template<uint16_t _size>
+    	template<uint32_t _size>
         int16_t write(Motate::Buffer<_size> &data, const uint16_t length = 0, bool autoFlush = false) {
             int16_t total_written = 0;
             int16_t to_write = length;
@@ -707,7 +707,7 @@ namespace Motate {
             return total_written;
         };
         
-        template<uint16_t _size>
+        template<uint32_t _size>
         int16_t write(Motate::Buffer<_size> &data, const uint16_t length = 0, bool autoFlush = false) {
             int16_t total_written = 0;
             int16_t to_write = length;
@@ -34,88 +34,613 @@
 #include <cstring> // for size_t
 //#include <utility> // for std::move
 #include <functional> // for std::function
+#include <type_traits> // for std::conditional
+
+#if !defined(__AVR__)
+#include <atomic> // for std::atomic and std::atomic_thread_fence
+#endif
 
 namespace Motate {
+    // An index shared between exactly one producer and one consumer (typically an interrupt
+    // and the main loop). Each side only ever stores to its own index, so we never need a
+    // read-modify-write -- plain loads and stores with acquire/release ordering are enough.
+    // On ARM that's a DMB around the access, which the Cortex-M7 (with its write buffer and
+    // cache) requires and the single-core M0/M3/M4 tolerate at very little cost.
+    //
+    // load()     - relaxed, for the owner reading back its own index
+    // acquire()  - for reading the *other* side's index before touching the data it guards
+    // release()  - for publishing our own index after we're done with the data
+#if defined(__AVR__)
+    // AVR has no <atomic>, but it's single-core and in-order, so volatile and a compiler
+    // barrier are all we need.
+    template <typename index_t>
+    struct SPSCIndex {
+        volatile index_t _value;
+
+        constexpr SPSCIndex(const index_t value = 0) : _value{value} {};
+
+        index_t load() const { return _value; };
+        index_t acquire() const { index_t v = _value; __asm__ __volatile__ ("" ::: "memory"); return v; };
+        void release(const index_t value) { __asm__ __volatile__ ("" ::: "memory"); _value = value; };
+    };
+
+    inline void _acquireFence() { __asm__ __volatile__ ("" ::: "memory"); };
+    inline void _releaseFence() { __asm__ __volatile__ ("" ::: "memory"); };
+#else
+    template <typename index_t>
+    struct SPSCIndex {
+        std::atomic<index_t> _value;
+
+        constexpr SPSCIndex(const index_t value = 0) : _value{value} {};
+
+        index_t load() const { return _value.load(std::memory_order_relaxed); };
+        index_t acquire() const { return _value.load(std::memory_order_acquire); };
+        void release(const index_t value) { _value.store(value, std::memory_order_release); };
+    };
+
+    inline void _acquireFence() { std::atomic_thread_fence(std::memory_order_acquire); };
+    inline void _releaseFence() { std::atomic_thread_fence(std::memory_order_release); };
+#endif
+
+    // A word that several writers (any of them possibly an interrupt) update with compare-and-swap.
+    // On the Cortex-M3/M4/M7 that's LDREX/STREX. The M0 and AVR don't have those, so there
+    // it's a critical section just long enough for the compare and the store.
+    // _BufferCounter is the same idea for a count that several writers add to.
+#if defined(__AVR__) || defined(__ARM_ARCH_6M__)
+    struct _BufferCriticalSection {
+#if defined(__AVR__)
+        uint8_t _saved;
+        _BufferCriticalSection() { __asm__ __volatile__ ("in %0, __SREG__" "\n\t" "cli" : "=r" (_saved) :: "memory"); };
+        ~_BufferCriticalSection() { __asm__ __volatile__ ("out __SREG__, %0" :: "r" (_saved) : "memory"); };
+#else
+        uint32_t _saved;
+        _BufferCriticalSection() { __asm__ __volatile__ ("mrs %0, primask" "\n\t" "cpsid i" : "=r" (_saved) :: "memory"); };
+        ~_BufferCriticalSection() { __asm__ __volatile__ ("msr primask, %0" :: "r" (_saved) : "memory"); };
+#endif
+    };
+
+    template <typename value_t>
+    struct _BufferCASWord {
+        volatile value_t _value;
+
+        constexpr _BufferCASWord(const value_t value = 0) : _value{value} {};
+
+        value_t load() const { value_t v = _value; _acquireFence(); return v; };
+        void store(const value_t value) { _releaseFence(); _value = value; };
+        bool cas(value_t &expected, const value_t desired) {
+            _BufferCriticalSection cs;
+            if (_value == expected) {
+                _value = desired;
+                return true;
+            }
+            expected = _value;
+            return false;
+        };
+    };
+
+    struct _BufferCounter {
+        volatile uint32_t _value = 0;
+
+        uint32_t load() const { return _value; };
+        void store(const uint32_t value) { _value = value; };
+        void add(const uint32_t count) {
+            _BufferCriticalSection cs;
+            _value = _value + count;
+        };
+    };
+#else
+    template <typename value_t>
+    struct _BufferCASWord {
+        std::atomic<value_t> _value;
+
+        constexpr _BufferCASWord(const value_t value = 0) : _value{value} {};
+
+        value_t load() const { return _value.load(std::memory_order_acquire); };
+        void store(const value_t value) { _value.store(value, std::memory_order_release); };
+        bool cas(value_t &expected, const value_t desired) {
+            return _value.compare_exchange_weak(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+        };
+    };
+
+    struct _BufferCounter {
+        std::atomic<uint32_t> _value {0};
+
+        uint32_t load() const { return _value.load(std::memory_order_relaxed); };
+        void store(const uint32_t value) { _value.store(value, std::memory_order_relaxed); };
+        void add(const uint32_t count) { _value.fetch_add(count, std::memory_order_relaxed); };
+    };
+#endif
+
+    // Buffers pick the smallest unsigned type that can hold an offset into _data, so the
+    // small buffers used on AVR/XMega keep 8- or 16-bit math, while the large buffers we
+    // want on the SAMS70 (32KiB and up) get 32-bit offsets instead of silently wrapping.
+    template <uint32_t _size>
+    using BufferIndexType = typename std::conditional< (_size <= 0x100UL), uint8_t,
+                            typename std::conditional< (_size <= 0x10000UL), uint16_t, uint32_t >::type >::type;
+
+    // ... and the smallest signed type that can hold a count of 0 through _size (as from available()).
+    template <uint32_t _size>
+    using BufferSizeType = typename std::conditional< (_size <= 0x7FFFUL), int16_t, int32_t >::type;
+
+    // Optional buffer statistics, for sizing buffers from real-world data.
+    // Build with MOTATE_CONFIG_BUFFER_STATS=1 (in USER_DEFINES) to turn them on. When they're off
+    // the buffers inherit an empty BufferStats<false>, so they take no space and no time, but
+    // the query functions are still there (and return zero).
+    //
+    //   peakFill()            - the most values ever waiting in the buffer at once
+    //   dropped()             - values refused because the buffer was full (Buffer, TXBuffer
+    //                           write_nb(), MPTXBuffer)
+    //   fullStalls()          - times an RXBuffer had to leave the DMA stopped because it was
+    //                           full (not a count of bytes -- those pile up in the owner, if it
+    //                           has somewhere to put them, until the reader makes room)
+    //   restarts()            - calls to _restartTransfer() (DMA buffers)
+    //   transfers()           - DMA transfers actually started, and averageTransferSize() of those
+    //   blockedTime()         - time spent waiting in a blocking TXBuffer::write(), in units of
+    //                           the clock set with setBufferClock() (none by default, so zero)
+#ifndef MOTATE_CONFIG_BUFFER_STATS
+#define MOTATE_CONFIG_BUFFER_STATS 0
+#endif
+
+    // One clock shared by all buffers, such as []{ return SysTickTimer.getValue(); }
+    // (This header doesn't know about timers, so the application has to provide one.)
+    inline uint32_t (*&_bufferClock())() {
+        static uint32_t (*clock)() = nullptr;
+        return clock;
+    };
+    inline void setBufferClock(uint32_t (*clock)()) { _bufferClock() = clock; };
+    inline uint32_t _bufferTime() { return _bufferClock() ? _bufferClock()() : 0; };
+
+    template <bool enabled>
+    struct BufferStats {
+        void _recordFill(const uint32_t) {};
+        void _recordDropped(const uint32_t = 1) {};
+        void _recordFullStall() {};
+        void _recordRestart() {};
+        void _recordTransfer(const uint32_t) {};
+        uint32_t _blockedStart() { return 0; };
+        void _recordBlocked(const uint32_t) {};
+
+        uint32_t peakFill() const { return 0; };
+        uint32_t dropped() const { return 0; };
+        uint32_t fullStalls() const { return 0; };
+        uint32_t restarts() const { return 0; };
+        uint32_t transfers() const { return 0; };
+        uint32_t averageTransferSize() const { return 0; };
+        uint32_t blockedTime() const { return 0; };
+        void resetStats() {};
+    };
+
+    // _dropped and _restarts are added to by every writer of an MPTXBuffer (some of them
+    // interrupts), so they're _BufferCounters rather than a plain += that could lose counts,
+    // and _peak_fill is raised with a compare-and-swap for the same reason.
+    template <>
+    struct BufferStats<true> {
+        _BufferCASWord<uint32_t> _peak_fill;
+        _BufferCounter _dropped;
+        volatile uint32_t _full_stalls = 0;
+        _BufferCounter _restarts;
+        volatile uint32_t _transfers = 0;
+        volatile uint32_t _transfer_total = 0;
+        volatile uint32_t _blocked_time = 0;
+
+        void _recordFill(const uint32_t fill) {
+            uint32_t peak = _peak_fill.load();
+            while ((fill > peak) && !_peak_fill.cas(peak, fill)) {}
+        };
+        void _recordDropped(const uint32_t count = 1) { _dropped.add(count); };
+        void _recordFullStall() { _full_stalls++; };
+        void _recordRestart() { _restarts.add(1); };
+        void _recordTransfer(const uint32_t length) { _transfers++; _transfer_total += length; };
+        uint32_t _blockedStart() { return _bufferTime(); };
+        void _recordBlocked(const uint32_t start) { _blocked_time += _bufferTime() - start; };
+
+        uint32_t peakFill() const { return _peak_fill.load(); };
+        uint32_t dropped() const { return _dropped.load(); };
+        uint32_t fullStalls() const { return _full_stalls; };
+        uint32_t restarts() const { return _restarts.load(); };
+        uint32_t transfers() const { return _transfers; };
+        uint32_t averageTransferSize() const { return _transfers ? (_transfer_total / _transfers) : 0; };
+        uint32_t blockedTime() const { return _blocked_time; };
+        void resetStats() { _peak_fill.store(0); _dropped.store(0); _full_stalls = 0; _restarts.store(0); _transfers = 0; _transfer_total = 0; _blocked_time = 0; };
+    };
+
+    // Optional receive timestamps, for measuring how long data sits in an RXBuffer.
+    // Build with MOTATE_CONFIG_BUFFER_TIMESTAMPS=1 (in USER_DEFINES) and set a clock with
+    // setBufferClock(). Like BufferStats, when they're off this is empty and costs nothing.
+    //
+    // Each time the buffer sees the DMA write position move (at the end of every transfer, in
+    // the interrupt, and whenever a transfer is restarted) it records a mark: "everything before
+    // this offset had arrived by this time". A value's age is measured from the first mark that
+    // covers it, so it's a lower bound -- the finer the marks, the closer it is.
+    //
+    //   age(offset)   - time since the value at offset was known to be in the buffer
+    //   frontAge()    - the same, for the next value to be read
+#ifndef MOTATE_CONFIG_BUFFER_TIMESTAMPS
+#define MOTATE_CONFIG_BUFFER_TIMESTAMPS 0
+#endif
+
+    template <bool enabled, uint32_t _size, typename index_t>
+    struct BufferTimestamps {
+        void _stampArrival(const index_t) {};
+        void _stampConsumed(const index_t, const index_t) {};
+        uint32_t _ageOf(const index_t, const index_t) { return 0; };
+    };
+
+    template <uint32_t _size, typename index_t>
+    struct BufferTimestamps<true, _size, index_t> {
+        static constexpr uint8_t _mark_count = 8; // 2^N
+
+        struct _Mark {
+            index_t end;   // everything before here ...
+            uint32_t time; // ... had arrived by now
+        };
+        _Mark _marks[_mark_count];
+
+        // Marks are written by the side that restarts transfers (which is serialized), and
+        // dropped by the reader as it passes them.
+        volatile uint8_t _mark_write = 0;
+        volatile uint8_t _mark_read = 0;
+        index_t _last_mark_end = 0;
+
+        // Reader-side fallback, for values past the newest mark (if the marks were full)
+        index_t _seen_end = 0;
+        uint32_t _seen_time = 0;
+
+        void _stampArrival(const index_t write_offset) {
+            if (write_offset == _last_mark_end) {
+                return;
+            }
+            uint8_t next = (_mark_write + 1) & (_mark_count - 1);
+            if (next == _mark_read) {
+                return; // full, a later mark will cover these values
+            }
+            _marks[_mark_write].end = write_offset;
+            _marks[_mark_write].time = _bufferTime();
+            _releaseFence();
+            _mark_write = next;
+            _last_mark_end = write_offset;
+        };
+
+        // The reader moved from old_read_offset past length values.
+        void _stampConsumed(const index_t old_read_offset, const index_t length) {
+            while (_mark_read != _mark_write) {
+                if (((_marks[_mark_read].end - old_read_offset)&(_size-1)) > length) {
+                    break;
+                }
+                _mark_read = (_mark_read + 1) & (_mark_count - 1);
+            }
+            // The fallback only covers up to _seen_end, so once the reader is past that it
+            // covers nothing (rather than a whole lap, with a stale time)
+            if (((_seen_end - old_read_offset)&(_size-1)) <= length) {
+                _seen_end = (old_read_offset + length)&(_size-1);
+            }
+        };
+
+        uint32_t _ageOf(const index_t offset, const index_t read_offset) {
+            index_t distance = (offset - read_offset)&(_size-1);
+            for (uint8_t i = _mark_read; i != _mark_write; i = (i + 1) & (_mark_count - 1)) {
+                _acquireFence();
+                if (((_marks[i].end - read_offset)&(_size-1)) > distance) {
+                    return _bufferTime() - _marks[i].time;
+                }
+            }
+
+            // Nothing covers it yet, so the best we know is when we first looked
+            if (((_seen_end - read_offset)&(_size-1)) <= distance) {
+                _seen_end = (offset + 1)&(_size-1);
+                _seen_time = _bufferTime();
+            }
+            return _bufferTime() - _seen_time;
+        };
+    };
+
     // Implement a simple circular buffer, with a compile-time size
-    template <uint16_t _size, typename base_type = char>
-    struct Buffer {
+    // This is lock-free for one writer and one reader (each may be an interrupt).
+    template <uint32_t _size, typename base_type = char, typename index_t = BufferIndexType<_size>>
+    struct Buffer : BufferStats<MOTATE_CONFIG_BUFFER_STATS> {
         static_assert(((_size-1)&_size)==0, "Buffer size must be 2^N");
+        static_assert((_size-1) <= index_t(~index_t(0)), "Buffer index_t is too small for _size");
+
+        typedef index_t index_type;              // offsets and span lengths
+        typedef BufferSizeType<_size> size_type; // counts, as from available()
 
         // Internal properties!
         base_type _data[_size+1];
 
-        volatile uint16_t _read_offset;              // The offset into the buffer of our next read
-        volatile uint16_t _write_offset;             // The offset into the buffer of our next write
+        SPSCIndex<index_t> _read_offset;              // The offset into the buffer of our next read (owned by the reader)
+        SPSCIndex<index_t> _write_offset;             // The offset into the buffer of our next write (owned by the writer)
 
         Buffer() { _data[_size] = 0; };
 
-        uint16_t _nextReadOffset() {
-            return (_read_offset + 1)&(_size-1);
+        index_t _nextReadOffset() {
+            return (_read_offset.load() + 1)&(_size-1);
         };
 
-        uint16_t _nextWriteOffset() {
-            return (_write_offset + 1)&(_size-1);
+        index_t _nextWriteOffset() {
+            return (_write_offset.load() + 1)&(_size-1);
         };
 
-        constexpr int16_t size() { return _size; };
+        constexpr size_type size() { return _size; };
 
-        bool isEmpty() { return _read_offset == _write_offset; }
-        bool isFull() { return ((_write_offset+1)&(_size-1)) == _read_offset; }
+        // These can be called from either side, so they acquire both
+        bool isEmpty() { return _read_offset.acquire() == _write_offset.acquire(); }
+        bool isFull() { return ((_write_offset.acquire()+1)&(_size-1)) == _read_offset.acquire(); }
         bool isLocked() { return false; }
 
+        // Reader side
+
+        // The reader can't go past what it has seen from the writer, so it acquires
+        // _write_offset before reading the data, and releases _read_offset after.
+        bool _canRead() { return _read_offset.load() != _write_offset.acquire(); }
+
         int16_t peek() {
-            if (isEmpty())
+            if (!_canRead())
                 return -1;
 
-            int16_t ret = _data[_read_offset];
+            int16_t ret = _data[_read_offset.load()];
             return ret;
         };
 
         void pop() {
-            if (isEmpty())
+            if (!_canRead())
                 return; // Ignore pop on an empty buffer
 
-            _read_offset = _nextReadOffset();
+            _read_offset.release(_nextReadOffset());
             return;
         };
 
         int16_t read() {
-            if (isEmpty()) {
+            if (!_canRead()) {
                 return -1;
             }
 
-            int16_t ret = _data[_read_offset];
-            _read_offset = _nextReadOffset();
+            int16_t ret = _data[_read_offset.load()];
+            _read_offset.release(_nextReadOffset());
 
             return ret;
         };
 
+        // Writer side
+
+        // The writer acquires _read_offset before overwriting a slot the reader may have
+        // just finished with, and releases _write_offset after the data is in place.
+        bool _canWrite() { return _nextWriteOffset() != _read_offset.acquire(); }
+
         int16_t write(const base_type newValue) {
-            if (isFull())
+            if (!_canWrite()) {
+                _recordDropped();
                 return -1;
-            
-            _data[_write_offset] = newValue;
-            _write_offset = _nextWriteOffset();
+            }
+
+            _data[_write_offset.load()] = newValue;
+            _write_offset.release(_nextWriteOffset());
+            _recordFill((_write_offset.load() - _read_offset.load())&(_size-1));
 
             return 1;
         };
 
-        int16_t available() {
-            if (_write_offset == _read_offset) {
+        size_type available() {
+            index_t read_offset = _read_offset.acquire();
+            index_t write_offset = _write_offset.acquire();
+            if (write_offset == read_offset) {
                 return _size;
-            } else if (_write_offset < _read_offset) {
-                return _size  - (_read_offset - _write_offset);
+            } else if (write_offset < read_offset) {
+                return read_offset - write_offset;
+            } else {
+                return (read_offset) + (_size - write_offset);
+            }
+        };
+
+        // Span access: these hand out pointers directly into _data, so callers (parsers,
+        // DMA setup, memcpy) can work on whole runs instead of one byte at a time.
+
+        // Returns a pointer to the largest contiguous readable run, and sets length to its size.
+        // A length of zero means the buffer is empty.
+        base_type *readSpan(index_t &length) {
+            index_t read_offset = _read_offset.load();
+            index_t write_offset = _write_offset.acquire();
+            if (read_offset <= write_offset) {
+                length = write_offset - read_offset;
             } else {
-                return (_read_offset) + (_size - _write_offset);
+                length = _size - read_offset;
             }
+            return _data + read_offset;
+        };
+
+        // Mark length values (from readSpan) as read.
+        void consume(const index_t length) {
+            _read_offset.release((_read_offset.load() + length)&(_size-1));
+        };
+
+        // Returns a pointer to the largest contiguous writable run, and sets length to its size.
+        // A length of zero means the buffer is full. Nothing is visible to the reader until commit().
+        base_type *reserve(index_t &length) {
+            index_t read_offset = _read_offset.acquire();
+            index_t write_offset = _write_offset.load();
+            if (read_offset > write_offset) {
+                length = (read_offset - write_offset) - 1;
+            } else if (read_offset == 0) {
+                // We can't fill to the end, or full would look like empty
+                length = (_size - write_offset) - 1;
+            } else {
+                length = _size - write_offset;
+            }
+            return _data + write_offset;
+        };
+
+        // Publish length values (written into the span from reserve) to the reader.
+        void commit(const index_t length) {
+            _write_offset.release((_write_offset.load() + length)&(_size-1));
+            _recordFill((_write_offset.load() - _read_offset.load())&(_size-1));
         };
     };
 
+    // A circular queue of fixed-size records (structs), with a compile-time size.
+    // Buffer is for bytes (read() returns int16_t with -1 for empty), this is for anything else:
+    // step segments, SPI jobs, ADC samples, etc. Records are moved with memcpy, so they must be
+    // trivially copyable. Lock-free for one writer and one reader (each may be an interrupt),
+    // the same as Buffer. It holds _size-1 records.
+    template <uint32_t _size, typename record_t, typename index_t = BufferIndexType<_size>>
+    struct RecordQueue {
+        static_assert(((_size-1)&_size)==0, "RecordQueue size must be 2^N");
+        static_assert((_size-1) <= index_t(~index_t(0)), "RecordQueue index_t is too small for _size");
+#if !defined(__AVR__)
+        static_assert(std::is_trivially_copyable<record_t>::value, "RecordQueue record_t must be trivially copyable");
+#endif
+
+        typedef index_t index_type;              // offsets and counts
+
+        // Internal properties!
+        record_t _data[_size];
+
+        SPSCIndex<index_t> _read_offset;              // The offset into the queue of our next read (owned by the reader)
+        SPSCIndex<index_t> _write_offset;             // The offset into the queue of our next write (owned by the writer)
+
+        constexpr uint32_t size() { return _size-1; };
+
+        // These can be called from either side, so they acquire both
+        bool isEmpty() { return _read_offset.acquire() == _write_offset.acquire(); }
+        bool isFull() { return ((_write_offset.acquire()+1)&(_size-1)) == _read_offset.acquire(); }
+        index_t count() { return (_write_offset.acquire() - _read_offset.acquire())&(_size-1); }
+
+        // Reader side
+
+        // Returns a pointer to the largest contiguous run of records, and sets length to its size.
+        // A length of zero means the queue is empty. Release them with consume().
+        record_t *readSpan(index_t &length) {
+            index_t read_offset = _read_offset.load();
+            index_t write_offset = _write_offset.acquire();
+            if (read_offset <= write_offset) {
+                length = write_offset - read_offset;
+            } else {
+                length = _size - read_offset;
+            }
+            return _data + read_offset;
+        };
+
+        // Mark length records (from readSpan or front) as read.
+        void consume(const index_t length = 1) {
+            _read_offset.release((_read_offset.load() + length)&(_size-1));
+        };
+
+        // The oldest record, in place, or nullptr if the queue is empty.
+        record_t *front() {
+            if (_read_offset.load() == _write_offset.acquire()) {
+                return nullptr;
+            }
+            return _data + _read_offset.load();
+        };
+
+        bool try_pop(record_t &record) {
+            record_t *src = front();
+            if (src == nullptr) {
+                return false;
+            }
+            std::memcpy(&record, src, sizeof(record_t));
+            consume();
+            return true;
+        };
+
+        // Pop up to count records into records, returning how many were popped.
+        index_t pop(record_t *records, const index_t count) {
+            index_t popped = 0;
+            index_t length;
+            // At most twice: up to the end of _data, then from the beginning
+            for (uint8_t i = 0; i < 2 && popped < count; i++) {
+                record_t *src = readSpan(length);
+                if (length == 0) {
+                    break;
+                }
+                if (length > (count - popped)) {
+                    length = count - popped;
+                }
+                std::memcpy(records + popped, src, length * sizeof(record_t));
+                consume(length);
+                popped += length;
+            }
+            return popped;
+        };
+
+        // Writer side
+
+        // Returns a pointer to the largest contiguous run of free records, and sets length to its size.
+        // A length of zero means the queue is full. Nothing is visible to the reader until commit().
+        record_t *reserve(index_t &length) {
+            index_t read_offset = _read_offset.acquire();
+            index_t write_offset = _write_offset.load();
+            if (read_offset > write_offset) {
+                length = (read_offset - write_offset) - 1;
+            } else if (read_offset == 0) {
+                // We can't fill to the end, or full would look like empty
+                length = (_size - write_offset) - 1;
+            } else {
+                length = _size - write_offset;
+            }
+            return _data + write_offset;
+        };
+
+        // Publish length records (written into reserve or emplace) to the reader.
+        void commit(const index_t length = 1) {
+            _write_offset.release((_write_offset.load() + length)&(_size-1));
+        };
+
+        // The next free record, to be filled in place and then commit()ed, or nullptr if the queue is full.
+        record_t *emplace() {
+            if (((_write_offset.load()+1)&(_size-1)) == _read_offset.acquire()) {
+                return nullptr;
+            }
+            return _data + _write_offset.load();
+        };
+
+        bool try_push(const record_t &record) {
+            record_t *dst = emplace();
+            if (dst == nullptr) {
+                return false;
+            }
+            std::memcpy(dst, &record, sizeof(record_t));
+            commit();
+            return true;
+        };
+
+        // Push up to count records from records, returning how many were pushed.
+        index_t push(const record_t *records, const index_t count) {
+            index_t pushed = 0;
+            index_t length;
+            // At most twice: up to the end of _data, then from the beginning
+            for (uint8_t i = 0; i < 2 && pushed < count; i++) {
+                record_t *dst = reserve(length);
+                if (length == 0) {
+                    break;
+                }
+                if (length > (count - pushed)) {
+                    length = count - pushed;
+                }
+                std::memcpy(dst, records + pushed, length * sizeof(record_t));
+                commit(length);
+                pushed += length;
+            }
+            return pushed;
+        };
+    }; // RecordQueue
+
     // Implement a simple circular buffer, with a compile-time size, and can only be written to by DMA
     // owner_type is a *pointer* type thet implements const base_type* getRXTransferPosition()
-    template <uint16_t _size, typename owner_type, typename base_type = char>
-    struct RXBuffer {
+    // and bool startRXTransfer(base_type *&buffer, length, bool include_next). With include_next
+    // the transfer is queued behind the running one, and owners that can't do that return false.
+    template <uint32_t _size, typename owner_type, typename base_type = char, typename index_t = BufferIndexType<_size>>
+    struct RXBuffer : BufferStats<MOTATE_CONFIG_BUFFER_STATS>, BufferTimestamps<MOTATE_CONFIG_BUFFER_TIMESTAMPS, _size, index_t> {
         static_assert(((_size-1)&_size)==0, "RXBuffer size must be 2^N");
+        static_assert((_size-1) <= index_t(~index_t(0)), "RXBuffer index_t is too small for _size");
+
+        typedef index_t index_type;              // offsets and span lengths
+        typedef BufferSizeType<_size> size_type; // counts, as from available()
+
+        // Owners take a uint16_t transfer length (and the PDC counters are 16 bits), so
+        // large buffers are handed to the DMA in chunks no bigger than this.
+        static constexpr uint32_t _max_transfer_size = 0xFFFF;
+
+        // The shortest "next" transfer worth queueing behind the current one (see _requestTransfers())
+        static constexpr uint32_t _min_next_transfer = (_size >= 256) ? 16 : ((_size >= 32) ? (_size / 16) : 1);
 
         owner_type _owner;
 
@@ -124,28 +649,99 @@ namespace Motate {
 
         uint32_t _data_end_guard = 0xBEEF;
 
-        volatile uint16_t _read_offset;              // The offset into the buffer of our next read
-        volatile uint16_t _last_known_write_offset;  // The offset into the buffer of the last known write (cached)
-
-        volatile uint16_t _transfer_requested = 0; // keep track of how much we have requested. Non-zero means a request is active.
-        volatile uint16_t _requested_check = 0;
-
-        constexpr int16_t size() { return _size; };
+        volatile index_t _read_offset = 0;          // The offset into the buffer of our next read
+        volatile index_t _last_known_write_offset = 0; // The offset into the buffer of the last known write (cached)
+
+        volatile index_t _transfer_requested = 0; // keep track of how much we have requested. Non-zero means a request is active.
+        volatile index_t _requested_check = 0;
+
+        volatile index_t _next_transfer_requested = 0; // the same, for the transfer queued up behind that one
+        volatile index_t _next_requested_check = 0;
+
+        // Set while _restartTransfer() is running, so a transfer-done interrupt can leave its work for us
+        volatile bool _restarting = false;
+        volatile bool _transfer_done_pending = false;
+
+        // Line index: offsets of the delimiters found past _read_offset, oldest first.
+        // Only the reader touches these, so they don't need to be volatile.
+        static constexpr uint8_t _line_index_size = 8;
+        index_t _line_ends[_line_index_size] = {};
+        uint8_t _line_head = 0;           // index into _line_ends of the oldest entry
+        uint8_t _line_count = 0;          // number of valid entries
+        index_t _lines_waiting = 0;       // every delimiter found past _read_offset, stored or not
+        index_t _scan_offset = 0;         // the next offset to check for a delimiter
+        index_t _index_offset = 0;        // the next offset to check for one to store (behind
+                                          //   _scan_offset only if _line_ends filled up)
+        base_type _line_delimiter = '\n';
+
+        // Flow control: once _high_water values are waiting, _flow_callback(true) asks the owner to
+        // stop the other side (with XOFF, say), and once reading brings that under _low_water,
+        // _flow_callback(false) lets it go again. A transfer is split where the high mark will be
+        // reached, so the transfer-done interrupt sees it then, not once the buffer is full.
+        // The fill is checked wherever the write position is (in the interrupt and in the reader),
+        // so a decision made on a stale fill is put right at the next check.
+        index_t _high_water = 0;
+        index_t _low_water = 0;
+        volatile bool _flow_stopped = false;
+        std::function<void(bool)> _flow_callback;
+
+        // If non-zero, no transfer is longer than this, so the owner sees what arrived (to look for
+        // an XOFF, say) at least this often.
+        uint32_t _transfer_limit = 0;
+
+        constexpr size_type size() { return _size; };
 
         RXBuffer(owner_type owner) : _owner(owner) { _data[_size] = 0; };
 
         void init() {
             _owner->setRXTransferDoneCallback([&]() { // use a closure
-                _transfer_requested = 0;
+                if (_restarting) {
+                    // we interrupted _restartTransfer(), it'll handle this on the way out
+                    _transfer_done_pending = true;
+                    return;
+                }
+                _transferDone();
                 _restartTransfer();
             });
         };
 
-        uint16_t _nextReadOffset() {
+        index_t _nextReadOffset() {
             return (_read_offset + 1)&(_size-1);
         };
 
-        bool _canBeRead(uint16_t pos) {
+        // high must be more than low, and less than _size. A null callback turns it off.
+        void setFlowControl(const index_t high, const index_t low, std::function<void(bool)> &&callback) {
+            _flow_callback = nullptr;
+            _high_water = high;
+            _low_water = low;
+            _flow_stopped = false;
+            _flow_callback = std::move(callback);
+        };
+
+        void setTransferLimit(const uint32_t limit) {
+            _transfer_limit = limit;
+        };
+
+        void _checkFlowMarks(const index_t fill) {
+            if (!_flow_callback) {
+                return;
+            }
+            if (!_flow_stopped) {
+                if (fill >= _high_water) {
+                    _flow_stopped = true;
+                    _flow_callback(true);
+                }
+            } else if (fill < _low_water) {
+                _flow_stopped = false;
+                _flow_callback(false);
+                if (_flow_stopped) {
+                    // the interrupt stopped it again while we were letting it go, and lost
+                    _flow_callback(true);
+                }
+            }
+        };
+
+        bool _canBeRead(index_t pos) {
 //            if (pos == _last_known_write_offset) {
                 _getWriteOffset();
                 if (pos == _last_known_write_offset) {
@@ -156,13 +752,18 @@ namespace Motate {
             return true;
         };
 
-        uint16_t _getWriteOffset() {
+        index_t _getWriteOffset() {
             base_type* pos = _owner->getRXTransferPosition();
             if (pos==nullptr) {
                 _last_known_write_offset = 0;
             } else {
                 _last_known_write_offset = (pos - _data) & (_size-1); // if it's one past the end, we want it to become zero
             }
+            // Don't let reads of the data get ahead of reading the DMA position
+            _acquireFence();
+            index_t fill = (_last_known_write_offset - _read_offset)&(_size-1);
+            _recordFill(fill);
+            _checkFlowMarks(fill);
             return _last_known_write_offset;
         }
 
@@ -202,6 +803,7 @@ namespace Motate {
         void flush() {
             // We can't stop the machinery, but we can "trow away" what we have read so far.
             _read_offset = _getWriteOffset();
+            _resetLineIndex();
         }
 
         int16_t peek() {
@@ -216,74 +818,176 @@ namespace Motate {
             if (isEmpty())
                 return; // Ignore pop on an empty buffer
 
-            _read_offset = _nextReadOffset();
+            _advanceReadOffset(1);
             return;
         };
 
+        // How much we can hand to the DMA in one contiguous chunk starting at start.
+        size_type _getTransferSize(const index_t start) {
+            size_type transfer_size = 0;
+
+            // Possible cases:
+            // We must keep in mind we don't want to read _size bytes, but _size-1.
+            // [0] _write_pos+1 = _read_pos
+            //     IOW: We're full. This falls out of [1] and [2a] as a size < 1.
+            // [1] _read_pos > _write_pos
+            //     IOW: We read to some position in the middle, and _write_pos is before it
+            //          The unread data is between read->end, then 0->write.
+            //          So, we transfer from _write_pos to the _read_pos position - 1.
+            // [2] _read_pos <= _write_pos
+            //     IOW: We read to some position in the middle, and _read_pos is in the range 0 through _write_pos.
+            //          So, we can transfer from _write_pos to the end of the buffer.
+            // [2a] _read_pos <= _write_pos && _read_pos == 0
+            //     IOW: If we read to the end, we will read _size bytes, and our "full" will look like "empty".
+            //          So, we read to the end of the buffer - 1.
+
+            // Additional note: SOME DMA systems transfer is 4-byte words, and so a non-4-byte transfer will
+            // drop 3 NULLS (or other garbage) into the area past what we requested. So, we are using
+            // transfer_size - 4 for case [1] to work around that.
+
+            // Case [1]
+            // If this would stop short of the end, by less than _min_next_transfer, stop that far
+            // from it instead, so what's left is never too short to queue as a "next" (see [2a]).
+            if (_read_offset > start) {
+                transfer_size = (_read_offset - start) - 4;
+                if (transfer_size < 1) {
+                    return 0;
+                }
+                if ((start < (_size - _min_next_transfer)) && ((uint32_t)(start + transfer_size) > (_size - _min_next_transfer))) {
+                    transfer_size = (_size - _min_next_transfer) - start;
+                }
+            // Case [2a]
+            // Stopping one short leaves a single slot at the end, for a one-value transfer of its
+            // own once the reader moves on -- too short to follow up in time as a "next". So stop
+            // _min_next_transfer short, if there's that much room. (The rest is still used, as
+            // the current transfer, if the DMA gets there before the reader moves.)
+            } else if (_read_offset == 0) {
+                transfer_size = (_size - start) - 1;
+                if ((uint32_t)transfer_size >= _min_next_transfer) {
+                    transfer_size -= _min_next_transfer - 1;
+                }
+
+            // Case [2]
+            } else {
+                transfer_size = (_size - start);
+            }
+
+            if ((uint32_t)transfer_size > _max_transfer_size) {
+                transfer_size = _max_transfer_size;
+            }
+            if (_transfer_limit && ((uint32_t)transfer_size > _transfer_limit)) {
+                transfer_size = _transfer_limit;
+            }
+
+            // End it where the high water mark will be reached (as of now -- reads can only make
+            // that later), so the fill only ever reaches it at the end of a transfer
+            if (_flow_callback) {
+                index_t fill = (start - _read_offset)&(_size-1);
+                if ((fill < _high_water) && ((uint32_t)transfer_size > (uint32_t)(_high_water - fill))) {
+                    transfer_size = _high_water - fill;
+                }
+            }
+            return transfer_size;
+        };
+
+        // A transfer finished. If a "next" transfer was queued then the DMA has moved on to it --
+        // unless the write position shows it finished that one too, which can happen if we are
+        // late hearing about the first.
+        void _transferDone() {
+            if (_next_transfer_requested && (_getWriteOffset() != _next_requested_check)) {
+                _transfer_requested = _next_transfer_requested;
+                _requested_check = _next_requested_check;
+            } else {
+                _transfer_requested = 0;
+            }
+            _next_transfer_requested = 0;
+        };
+
         void _restartTransfer() {
-            if ((_transfer_requested == 0)) {
-                // We use a do..while here to repeat until the transfer "takes".
-                // The transfer can only fail if the startRXTransfer immediately loaded data into
-                // the buffer.
-                do {
+            _recordRestart();
+            _restarting = true;
+            _requestTransfers();
+            _restarting = false;
+
+            // If a transfer finished while we were in _requestTransfers(), catch up now
+            while (_transfer_done_pending) {
+                _restarting = true;
+                _transfer_done_pending = false;
+                _transferDone();
+                _requestTransfers();
+                _restarting = false;
+            }
+        };
+
+        void _requestTransfers() {
+            // We use a do..while here to repeat until the transfer "takes".
+            // The transfer can only fail if the startRXTransfer immediately loaded data into
+            // the buffer.
+            do {
+                // Note when the data so far got here (no-op unless timestamps are on)
+                this->_stampArrival(_getWriteOffset());
+
+                if (_transfer_requested == 0) {
                     // We can only request contiguous chunks. Let's see what the next one is.
                     _getWriteOffset(); // cache the write position
 
-                    int16_t transfer_size = 0;
-                    base_type *_write_pos = _data + _last_known_write_offset;
-
-                    if (isFull()) {
+                    size_type transfer_size = _getTransferSize(_last_known_write_offset);
+                    if (transfer_size < 1) {
+                        _recordFullStall(); // full, so the DMA has to stay stopped
                         break;
                     }
 
-                    // Possible cases:
-                    // We must keep in mind we don't want to read _size bytes, but _size-1.
-                    // [0] _write_pos+1 = _read_pos
-                    //     We just eliminated that.
-                    // [1] _read_pos > _write_pos
-                    //     IOW: We read to some position in the middle, and _write_pos is before it
-                    //          The unread data is between read->end, then 0->write.
-                    //          So, we transfer from _write_pos to the _read_pos position - 1.
-                    // [2] _read_pos <= _write_pos
-                    //     IOW: We read to some position in the middle, and _read_pos is in the range 0 through _write_pos.
-                    //          So, we can transfer from _write_pos to the end of the buffer.
-                    // [2a] _read_pos <= _write_pos && _read_pos == 0
-                    //     IOW: If we read to the end, we will read _size bytes, and our "full" will look like "empty".
-                    //          So, we read to the end of the buffer - 1.
-
-                    // Additional note: SOME DMA systems transfer is 4-byte words, and so a non-4-byte transfer will
-                    // drop 3 NULLS (or other garbage) into the area past what we requested. So, we are using
-                    // transfer_size - 4 for case [1] to work around that.
-
-                    // Case [1]
-                    if (_read_offset > _last_known_write_offset) {
-                        transfer_size = (_read_offset - _last_known_write_offset) - 4;
-                        if (transfer_size < 1) {
-                            return;
-                        }
-                    // Case [2a]
-                    } else if (_read_offset == 0) {
-                        transfer_size = (_size - _last_known_write_offset) - 1;
-
-                    // Case [2]
-                    } else {
-                        transfer_size = (_size - _last_known_write_offset);
-                    }
+                    base_type *_write_pos = _data + _last_known_write_offset;
 
                     _transfer_requested = transfer_size;
 
                     _requested_check = (_last_known_write_offset+_transfer_requested) & (_size-1);
 
                     // startRXTransfer will return false if it couldn't start the transfer.
-                    if (_owner->startRXTransfer(_write_pos, transfer_size)) {
+                    if (!_owner->startRXTransfer(_write_pos, transfer_size)) {
+                        // If we're here, startRXTransfer loaded some data into the buffer and ran out of room.
+                        // Note that _getWriteOffset() must return the new position
+                        _transfer_requested = 0;
+                        continue;
+                    }
+                    _recordTransfer(transfer_size);
+                }
+
+                // Keep the following chunk queued up as well (the PDC "next" registers), so the DMA
+                // moves straight on to it and never has to wait for us to respond to an interrupt.
+                if (_next_transfer_requested == 0) {
+                    size_type transfer_size = _getTransferSize(_requested_check);
+                    if (transfer_size < 1) {
+                        break;
+                    }
+                    // A short chunk that stops at the reader (cases [1] and [2a]) only gets longer as the
+                    // reader moves on, so don't tie the slot up with it: the DMA would race through it
+                    // and stop before the interrupt could follow up. A later consume() will queue a
+                    // longer one.
+                    if (((uint32_t)transfer_size < _min_next_transfer) && ((_read_offset > _requested_check) || (_read_offset == 0))) {
                         break;
                     }
 
-                    // If we're here, startRXTransfer loaded some data into the buffer and ran out of room.
-                    // Note that _getWriteOffset() must return the new position
-                    _transfer_requested = 0;
-                } while (1);
-            }
+                    base_type *_write_pos = _data + _requested_check;
+
+                    _next_transfer_requested = transfer_size;
+
+                    _next_requested_check = (_requested_check+_next_transfer_requested) & (_size-1);
+
+                    // Owners that can't queue a transfer return false, as do owners that loaded the data
+                    // themselves (as above). We can tell those apart by the write position.
+                    if (!_owner->startRXTransfer(_write_pos, transfer_size, /*include_next =*/ true)) {
+                        _next_transfer_requested = 0;
+                        if (_getWriteOffset() == _next_requested_check) {
+                            _transfer_requested = 0;
+                            continue;
+                        }
+                    } else {
+                        _recordTransfer(transfer_size);
+                    }
+                }
+                break;
+            } while (1);
         };
 
         int16_t read() {
@@ -293,47 +997,564 @@ namespace Motate {
             }
 
             int16_t ret = _data[_read_offset];
-            _read_offset = _nextReadOffset();
+            _advanceReadOffset(1);
 
             return ret;
         };
 
-        int16_t _getAvailableCached() {
+        size_type _getAvailableCached() {
             if (_read_offset == _last_known_write_offset) {
                 return _size;
             } else if (_read_offset < _last_known_write_offset) {
                 return _size  - (_last_known_write_offset - _read_offset);
             } else {
-                return (_last_known_write_offset) + (_size - _read_offset);
+                return _read_offset - _last_known_write_offset;
             }
         };
 
 
-        int16_t available() {
+        size_type available() {
             _getWriteOffset(); // cache the write position
             return _getAvailableCached();
         };
+
+        // Returns a pointer to the largest contiguous run the DMA has already filled,
+        // and sets length to its size. A length of zero means the buffer is empty.
+        base_type *readSpan(index_t &length) {
+            _getWriteOffset(); // cache the write position
+
+            if (_read_offset <= _last_known_write_offset) {
+                length = _last_known_write_offset - _read_offset;
+            } else {
+                length = _size - _read_offset;
+            }
+
+            if (length == 0) {
+                _restartTransfer();
+            }
+            return _data + _read_offset;
+        };
+
+        // Mark length values (from readSpan) as read, and hand the freed space back to the DMA.
+        void consume(const index_t length) {
+            _advanceReadOffset(length);
+            _restartTransfer();
+        };
+
+        // Move the read offset, dropping any line index entries (and scan progress) we passed.
+        void _advanceReadOffset(const index_t length) {
+            index_t old_read_offset = _read_offset;
+            _read_offset = (old_read_offset + length)&(_size-1);
+
+            while (_line_count && (((_line_ends[_line_head] - old_read_offset)&(_size-1)) < length)) {
+                _line_head = (_line_head + 1) % _line_index_size;
+                _line_count--;
+                _lines_waiting--;
+            }
+            // If we passed delimiters that were counted but not stored, we don't know how many,
+            // so count again from here. (Reading line by line never does this.)
+            if (((_index_offset - old_read_offset)&(_size-1)) < length) {
+                _resetLineIndex();
+            }
+
+            this->_stampConsumed(old_read_offset, length);
+            _checkFlowMarks((_last_known_write_offset - _read_offset)&(_size-1));
+        };
+
+        // How long the value at offset (or the next one to be read) has been in the buffer.
+        // Always zero unless MOTATE_CONFIG_BUFFER_TIMESTAMPS is on -- see BufferTimestamps.
+        uint32_t age(const index_t offset) {
+            return this->_ageOf(offset, _read_offset);
+        };
+
+        uint32_t frontAge() {
+            return age(_read_offset);
+        };
+
+        // Line index -- for newline (or other delimiter) framed protocols.
+        // The index is brought up to date by the reader, in the calls below, not by the DMA
+        // interrupt. Each value that arrived since the last call is checked for the delimiter
+        // once, so the cost is spread over the reads rather than rescanning the whole buffer.
+        // Every delimiter is counted, and the positions of up to _line_index_size of them are
+        // kept. When more lines than that are waiting, the positions of the rest are found
+        // again (only as far as the count has already gone) as lines are read.
+        // A line longer than the buffer can never complete, so callers should still check
+        // isFull() and read it out in pieces.
+
+        void setLineDelimiter(const base_type delimiter) {
+            _line_delimiter = delimiter;
+            _resetLineIndex();
+        };
+
+        void _resetLineIndex() {
+            _line_count = 0;
+            _lines_waiting = 0;
+            _scan_offset = _read_offset;
+            _index_offset = _read_offset;
+        };
+
+        void _storeLineEnd(const index_t offset) {
+            _line_ends[(_line_head + _line_count) % _line_index_size] = offset;
+            _line_count++;
+        };
+
+        void _indexLines() {
+            // Catch up on positions we counted but had no room for
+            while ((_index_offset != _scan_offset) && (_line_count < _line_index_size)) {
+                if (_data[_index_offset] == _line_delimiter) {
+                    _storeLineEnd(_index_offset);
+                }
+                _index_offset = (_index_offset + 1)&(_size-1);
+            }
+
+            bool storing = (_index_offset == _scan_offset);
+            index_t write_offset = _getWriteOffset();
+            while (_scan_offset != write_offset) {
+                if (_data[_scan_offset] == _line_delimiter) {
+                    if (storing && (_line_count == _line_index_size)) {
+                        storing = false;
+                        _index_offset = _scan_offset; // come back for this one
+                    }
+                    if (storing) {
+                        _storeLineEnd(_scan_offset);
+                    }
+                    _lines_waiting++;
+                }
+                _scan_offset = (_scan_offset + 1)&(_size-1);
+            }
+            if (storing) {
+                _index_offset = _scan_offset;
+            }
+        };
+
+        // Number of complete lines waiting.
+        index_t linesAvailable() {
+            _indexLines();
+            return _lines_waiting;
+        };
+
+        // Length of the next complete line, including the delimiter, or 0 if there isn't one.
+        size_type lineLength() {
+            if (!linesAvailable()) {
+                return 0;
+            }
+            return ((_line_ends[_line_head] - _read_offset)&(_size-1)) + 1;
+        };
+
+        // Like readSpan, but stops at the end of the next complete line (including the delimiter).
+        // A line that wraps the end of the buffer comes back in two spans: consume() the first and
+        // call again for the rest. A length of zero means there's no complete line yet.
+        base_type *readLineSpan(index_t &length) {
+            length = 0;
+            if (linesAvailable()) {
+                index_t line_end = _line_ends[_line_head];
+                if (_read_offset <= line_end) {
+                    length = (line_end - _read_offset) + 1;
+                } else {
+                    length = _size - _read_offset;
+                }
+            }
+            return _data + _read_offset;
+        };
     }; // RXBuffer
 
 
+    // A bipartite ("bip") circular buffer, with a compile-time size, and can only be written to by DMA
+    // owner_type is a *pointer* type that implements the same interface as for RXBuffer:
+    //   bool startRXTransfer(base_type *&buffer, length), base_type* getRXTransferPosition(),
+    //   and setRXTransferDoneCallback(std::function<void()>&&)
+    //
+    // Unlike RXBuffer, a transfer never wraps and is never split at the end of _data. Instead,
+    // when the space at the end is smaller than the space at the beginning, the tail is left
+    // unused (up to the _last watermark) and the DMA is given the block at the beginning.
+    // So every transfer is the largest contiguous block available, and there is no "one
+    // empty slot" until the data wraps, so _size need not be 2^N.
+    //
+    // The DMA must not write past the end of the block it was handed. (The RXBuffer "minus 4"
+    // workaround for word-sized writes is intentionally not here -- transfers must be byte-wide.)
+    //
+    // Offsets:
+    //   _read_offset  - next read, owned by the reader
+    //   _write_offset - start of the current (or last) DMA block, owned by _restartTransfer()
+    //   _write_end    - end of that block (published first)
+    //   _last         - end of the valid data at the tail, set when the writer wraps
+    //   The live write position is taken from the DMA, as long as it's inside the current block.
+    template <uint32_t _size, typename owner_type, typename base_type = char, typename index_t = BufferIndexType<_size+1>>
+    struct RXBipBuffer {
+        static_assert(_size <= index_t(~index_t(0)), "RXBipBuffer index_t is too small for _size");
+
+        typedef index_t index_type;              // offsets and span lengths
+        typedef BufferSizeType<_size> size_type; // counts, as from available()
+
+        // Owners take a uint16_t transfer length (and the PDC counters are 16 bits), so
+        // large buffers are handed to the DMA in chunks no bigger than this.
+        static constexpr uint32_t _max_transfer_size = 0xFFFF;
+
+        owner_type _owner;
+
+        // Internal properties!
+        base_type _data[_size];
+
+        SPSCIndex<index_t> _read_offset;
+        SPSCIndex<index_t> _write_offset;
+        SPSCIndex<index_t> _write_end;
+        SPSCIndex<index_t> _last {_size};
+
+        volatile index_t _transfer_requested = 0; // keep track of how much we have requested. Non-zero means a request is active.
+
+        constexpr size_type size() { return _size; };
+
+        RXBipBuffer(owner_type owner) : _owner(owner) {};
+
+        void init() {
+            _owner->setRXTransferDoneCallback([&]() { // use a closure
+                _transfer_requested = 0;
+                _restartTransfer();
+            });
+        };
+
+        bool isLocked() { return false; } // this kind of buffer cannot be locked
+
+        // Where the DMA is writing now (or stopped writing). We only trust the DMA position
+        // if it's inside the block we last handed out, which also covers the moment between
+        // picking a new block and the owner actually starting it. (Seeing a new _write_end with
+        // an old _write_offset can only make us under-report, never over-report.)
+        index_t _getWriteOffset() {
+            index_t block_start = _write_offset.acquire();
+            index_t block_limit = _write_end.load();
+
+            index_t write_offset = block_start;
+            base_type* pos = _owner->getRXTransferPosition();
+            if ((pos >= _data + block_start) && (pos <= _data + block_limit)) {
+                write_offset = pos - _data;
+            }
+            // Don't let reads of the data get ahead of reading the DMA position
+            _acquireFence();
+            return write_offset;
+        };
+
+        // Returns the read offset, wrapping it first if we've read all of the tail.
+        index_t _getReadOffset(const index_t write_offset) {
+            index_t read_offset = _read_offset.load();
+            if ((read_offset == _last.acquire()) && (write_offset < read_offset)) {
+                read_offset = 0;
+                _read_offset.release(0);
+            }
+            return read_offset;
+        };
+
+        // Returns a pointer to the largest contiguous run the DMA has already filled,
+        // and sets length to its size. A length of zero means the buffer is empty.
+        base_type *readSpan(index_t &length) {
+            index_t write_offset = _getWriteOffset();
+            index_t read_offset = _getReadOffset(write_offset);
+
+            if (write_offset < read_offset) {
+                length = _last.load() - read_offset;
+            } else {
+                length = write_offset - read_offset;
+            }
+
+            if (length == 0) {
+                _restartTransfer();
+            }
+            return _data + read_offset;
+        };
+
+        // Mark length values (from readSpan) as read, and hand the freed space back to the DMA.
+        void consume(const index_t length) {
+            _read_offset.release(_read_offset.load() + length);
+            _restartTransfer();
+        };
+
+        bool isEmpty() {
+            index_t length;
+            readSpan(length);
+            return length == 0;
+        };
+
+        void flush() {
+            // We can't stop the machinery, but we can "throw away" what we have read so far.
+            index_t length;
+            readSpan(length);
+            while (length) {
+                consume(length);
+                readSpan(length);
+            }
+        };
+
+        int16_t peek() {
+            index_t length;
+            base_type *span = readSpan(length);
+            if (length == 0)
+                return -1;
+
+            int16_t ret = *span;
+            return ret;
+        };
+
+        void pop() {
+            index_t length;
+            readSpan(length);
+            if (length == 0)
+                return; // Ignore pop on an empty buffer
+
+            _read_offset.release(_read_offset.load() + 1);
+        };
+
+        int16_t read() {
+            index_t length;
+            base_type *span = readSpan(length);
+            if (length == 0)
+                return -1;
+
+            int16_t ret = *span;
+            _read_offset.release(_read_offset.load() + 1);
+            return ret;
+        };
+
+        // Find the largest contiguous free block, and where it starts.
+        // Possible cases:
+        // [1] _read_pos <= _write_pos
+        //     IOW: We haven't wrapped. Free space is from _write_pos to the end, and from
+        //          the beginning to _read_pos - 1 (if the reader had gotten back to the beginning,
+        //          the writer would stop there, and full would look like empty).
+        //          We take whichever is bigger, and if that's the beginning, mark _last.
+        // [2] _read_pos > _write_pos
+        //     IOW: We have wrapped, and the unread data is _read_pos->_last, then 0->_write_pos.
+        //          The only free block is from _write_pos to _read_pos - 1.
+        index_t _getFreeBlock(index_t &write_offset, index_t &block_start, bool &wraps) {
+            write_offset = _getWriteOffset();
+            index_t read_offset = _read_offset.acquire();
+
+            wraps = false;
+            block_start = write_offset;
+
+            // Case [1]
+            if (read_offset <= write_offset) {
+                index_t tail = _size - write_offset;
+                index_t head = (read_offset > 0) ? read_offset - 1 : 0;
+                if (head > tail) {
+                    wraps = true;
+                    block_start = 0;
+                    return head;
+                }
+                return tail;
+
+            // Case [2]
+            } else {
+                return (read_offset - write_offset) - 1;
+            }
+        };
+
+        size_type available() {
+            index_t write_offset, block_start;
+            bool wraps;
+            return _getFreeBlock(write_offset, block_start, wraps);
+        };
+
+        void _restartTransfer() {
+            if ((_transfer_requested == 0)) {
+                // We use a do..while here to repeat until the transfer "takes".
+                // The transfer can only fail if the startRXTransfer immediately loaded data into
+                // the buffer.
+                do {
+                    index_t write_offset, block_start;
+                    bool wraps;
+                    uint32_t transfer_size = _getFreeBlock(write_offset, block_start, wraps);
+
+                    if (transfer_size == 0) {
+                        break; // full
+                    }
+
+                    if (transfer_size > _max_transfer_size) {
+                        transfer_size = _max_transfer_size;
+                    }
+
+                    // Publish the watermark before the new block, so a reader that sees the
+                    // wrapped block also sees where the tail data ends.
+                    if (wraps) {
+                        _last.release(write_offset);
+                    }
+                    _write_end.release(block_start + transfer_size);
+                    _write_offset.release(block_start);
+
+                    _transfer_requested = transfer_size;
+
+                    base_type *_write_pos = _data + block_start;
+
+                    // startRXTransfer will return false if it couldn't start the transfer.
+                    if (_owner->startRXTransfer(_write_pos, transfer_size)) {
+                        break;
+                    }
+
+                    // If we're here, startRXTransfer loaded some data into the buffer and ran out of room.
+                    // Note that getRXTransferPosition() must return the new position
+                    _transfer_requested = 0;
+                } while (1);
+            }
+        };
+    }; // RXBipBuffer
+
+
+    // A circular buffer that the DMA fills continuously, wrapping around by itself (see
+    // DMA_XDMAC::startRXRing()), so there are no transfers to restart and no interrupts at all.
+    // owner_type is a *pointer* type that implements:
+    //   bool startRXRing(base_type *buffer, length), void stopRXRing(),
+    //   and base_type* getRXTransferPosition()
+    //
+    // The only thing shared with the DMA is its write position, so the reader owns everything
+    // here. Nothing holds the DMA back, though: the reader has to keep up, since anything left
+    // unread for a whole lap is overwritten (and a full lap looks the same as nothing at all).
+    template <uint32_t _size, typename owner_type, typename base_type = char, typename index_t = BufferIndexType<_size+1>>
+    struct RXRingBuffer {
+        static_assert(_size <= index_t(~index_t(0)), "RXRingBuffer index_t is too small for _size");
+
+        typedef index_t index_type;              // offsets and span lengths
+        typedef BufferSizeType<_size> size_type; // counts
+
+        owner_type _owner;
+
+        // Internal properties!
+        base_type _data[_size];
+
+        index_t _read_offset = 0;
+        bool _running = false;
+
+        constexpr size_type size() { return _size; };
+
+        RXRingBuffer(owner_type owner) : _owner(owner) {};
+
+        // Returns false if the owner can't do circular receive.
+        bool init() {
+            _read_offset = 0;
+            _running = _owner->startRXRing(_data, _size);
+            return _running;
+        };
+
+        void stop() {
+            if (_running) {
+                _owner->stopRXRing();
+                _running = false;
+            }
+        };
+
+        bool isRunning() { return _running; };
+
+        bool isLocked() { return false; } // this kind of buffer cannot be locked
+
+        // Where the DMA is writing now. At the end of a lap it may briefly point just past the
+        // end, which is the same place as the beginning. Anything else outside of _data (such as
+        // before it's started) is treated as no new data.
+        index_t _getWriteOffset() {
+            index_t write_offset = _read_offset;
+            base_type* pos = _owner->getRXTransferPosition();
+            if ((pos >= _data) && (pos <= _data + _size)) {
+                write_offset = pos - _data;
+                if (write_offset == _size) {
+                    write_offset = 0;
+                }
+            }
+            // Don't let reads of the data get ahead of reading the DMA position
+            _acquireFence();
+            return write_offset;
+        };
+
+        // Returns a pointer to the largest contiguous run the DMA has already filled,
+        // and sets length to its size. A length of zero means the buffer is empty.
+        base_type *readSpan(index_t &length) {
+            index_t write_offset = _getWriteOffset();
+
+            if (write_offset < _read_offset) {
+                length = _size - _read_offset;
+            } else {
+                length = write_offset - _read_offset;
+            }
+            return _data + _read_offset;
+        };
+
+        // Mark length values (from readSpan) as read.
+        void consume(const index_t length) {
+            index_t read_offset = _read_offset + length;
+            if (read_offset >= _size) {
+                read_offset -= _size;
+            }
+            _read_offset = read_offset;
+        };
+
+        size_type count() {
+            index_t write_offset = _getWriteOffset();
+            if (write_offset < _read_offset) {
+                return (_size - _read_offset) + write_offset;
+            }
+            return write_offset - _read_offset;
+        };
+
+        bool isEmpty() {
+            return _getWriteOffset() == _read_offset;
+        };
+
+        void flush() {
+            // We can't stop the machinery, but we can "throw away" what's there so far.
+            _read_offset = _getWriteOffset();
+        };
+
+        int16_t peek() {
+            index_t length;
+            base_type *span = readSpan(length);
+            if (length == 0)
+                return -1;
+
+            int16_t ret = *span;
+            return ret;
+        };
+
+        void pop() {
+            if (isEmpty())
+                return; // Ignore pop on an empty buffer
+
+            consume(1);
+        };
+
+        int16_t read() {
+            index_t length;
+            base_type *span = readSpan(length);
+            if (length == 0)
+                return -1;
+
+            int16_t ret = *span;
+            consume(1);
+            return ret;
+        };
+    }; // RXRingBuffer
+
+
 
     // Implement a simple circular buffer, with a compile-time size, and can only be read from by DMA
     // owner_type is a *pointer* type thet implements const base_type* getTXTransferPosition()
-    template <uint16_t _size, typename owner_type, typename base_type = char>
-    struct TXBuffer {
+    template <uint32_t _size, typename owner_type, typename base_type = char, typename index_t = BufferIndexType<_size>>
+    struct TXBuffer : BufferStats<MOTATE_CONFIG_BUFFER_STATS> {
         static_assert(((_size-1)&_size)==0, "TXBuffer size must be 2^N");
+        static_assert((_size-1) <= index_t(~index_t(0)), "TXBuffer index_t is too small for _size");
+
+        typedef index_t index_type;              // offsets and span lengths
+        typedef BufferSizeType<_size> size_type; // counts, as from available()
+
+        // Owners take a uint16_t transfer length (and the PDC counters are 16 bits), so
+        // large buffers are handed to the DMA in chunks no bigger than this.
+        static constexpr uint32_t _max_transfer_size = 0xFFFF;
 
         owner_type _owner;
 
         // Internal properties!
         base_type _data[_size+1];
 
-        uint16_t _write_offset;             // The offset into the buffer of our next write
-        uint16_t _last_known_read_offset;   // The offset into the buffer of the last known read (cached)
+        index_t _write_offset;             // The offset into the buffer of our next write
+        index_t _last_known_read_offset;   // The offset into the buffer of the last known read (cached)
 
-        uint16_t _transfer_requested = 0;   // keep track of how much we have requested. Non-zero means a request is active.
+        index_t _transfer_requested = 0;   // keep track of how much we have requested. Non-zero means a request is active.
 
-        constexpr int16_t size() { return _size; };
+        constexpr size_type size() { return _size; };
 
         TXBuffer(owner_type owner) : _owner(owner) { _data[_size] = 0; };
 
@@ -344,11 +1565,11 @@ namespace Motate {
             });
         }
 
-        uint16_t _nextWriteOffset() {
+        index_t _nextWriteOffset() {
             return (_write_offset + 1)&(_size-1);
         };
 
-        bool _canBeWritten(uint16_t pos) {
+        bool _canBeWritten(index_t pos) {
             if (pos == _last_known_read_offset) {
                 _getReadOffset();
                 if (pos == _last_known_read_offset) {
@@ -359,7 +1580,7 @@ namespace Motate {
             return true;
         };
 
-        uint16_t _getReadOffset() {
+        index_t _getReadOffset() {
             base_type* pos = _owner->getTXTransferPosition();
             if (pos==nullptr) {
                 _last_known_read_offset = 0;
@@ -407,11 +1628,12 @@ namespace Motate {
         }
 
         void _restartTransfer() {
+            _recordRestart();
             if ((_transfer_requested == 0) && !isEmpty()) {
                 // We can only request contiguous chunks. Let's see what the next one is.
                 _getReadOffset(); // cache the read position
 
-                int16_t transfer_size = 0;
+                size_type transfer_size = 0;
                 base_type *_read_pos = _data + _last_known_read_offset;
 
                 // Possible cases:
@@ -434,49 +1656,62 @@ namespace Motate {
                     transfer_size = _write_offset - _last_known_read_offset;
                 }
 
+                if ((uint32_t)transfer_size > _max_transfer_size) {
+                    transfer_size = _max_transfer_size;
+                }
+
                 // We set _transfer_requested BEFORE startRXTransfer, in case an interrupt fires before we exit startRXTransfer
                 //   (which should only happen if it started succesfully).
                 // startRXTransfer will return false if it couldn't start the transfer.
                 _transfer_requested = transfer_size;
+
+                // Make sure the data is out of the write buffer before the DMA goes looking for it
+                _releaseFence();
                 if (!_owner->startTXTransfer(_read_pos, transfer_size)) {
                     _transfer_requested = 0;
+                } else {
+                    _recordTransfer(transfer_size);
                 }
             }
         };
 
-        // BLOCKING write
-        int16_t write(const char *buffer, size_t write_size) {
-            uint16_t to_write = write_size;
+        // BLOCKING write, returns write_size
+        size_t write(const char *buffer, size_t write_size) {
+            size_t to_write = write_size;
             const char *src = buffer;
             while (to_write--) {
                 if (isFull()) {
                     _restartTransfer();
 
                     // Wait until something has been read out
+                    uint32_t blocked_start = _blockedStart();
                     while (isFull()) {
                         ;
                     }
+                    _recordBlocked(blocked_start);
                 }
                 _data[_write_offset] = *src;
 
                 src++;
                 _write_offset = _nextWriteOffset();
             }
+            _recordFill((_write_offset - _last_known_read_offset)&(_size-1));
 
             _restartTransfer();
 
             return write_size;
         };
 
-        // non-blocking write
-        int16_t write_nb(const char *buffer, size_t write_size) {
+        // non-blocking write, returns how many fit (0 if it's full)
+        size_t write_nb(const char *buffer, size_t write_size) {
             if (isFull()) {
                 _restartTransfer();
-                return -1;
+                _recordDropped(write_size);
+                return 0;
             }
 
-            uint16_t written = 0;
-            uint16_t to_write = write_size;
+            size_t written = 0;
+            size_t to_write = write_size;
             const char *src = buffer;
             while (to_write-- && !isFull()) {
                 _data[_write_offset] = *src;
@@ -486,30 +1721,263 @@ namespace Motate {
                 _write_offset = _nextWriteOffset();
             }
 
+            _recordFill((_write_offset - _last_known_read_offset)&(_size-1));
             if (isFull()) {
                 _restartTransfer();
             }
+            _recordDropped(write_size - written);
 
             return written;
         };
 
 
-        int16_t _getAvailableCached() {
+        size_type _getAvailableCached() {
             if (_write_offset == _last_known_read_offset) {
                 return _size;
             } else if (_write_offset < _last_known_read_offset) {
-                return _size  - (_last_known_read_offset - _write_offset);
+                return _last_known_read_offset - _write_offset;
             } else {
                 return (_last_known_read_offset) + (_size - _write_offset);
             }
         };
         
         
-        int16_t available() {
+        size_type available() {
             _getReadOffset(); // cache the write position
             return _getAvailableCached();
         };
+
+        // Returns a pointer to the largest contiguous run that can be written without
+        // overtaking the DMA, and sets length to its size. A length of zero means the buffer is full.
+        // Nothing is sent until commit() is called.
+        base_type *reserve(index_t &length) {
+            _getReadOffset(); // cache the read position
+
+            if (_last_known_read_offset > _write_offset) {
+                length = (_last_known_read_offset - _write_offset) - 1;
+            } else if (_last_known_read_offset == 0) {
+                // We can't fill to the end, or full would look like empty
+                length = (_size - _write_offset) - 1;
+            } else {
+                length = _size - _write_offset;
+            }
+            return _data + _write_offset;
+        };
+
+        // Publish length values (written into the span from reserve) and start sending them.
+        void commit(const index_t length) {
+            _write_offset = (_write_offset + length)&(_size-1);
+            _recordFill((_write_offset - _last_known_read_offset)&(_size-1));
+            _restartTransfer();
+        };
     }; // TXBuffer
+
+
+    // A TXBuffer that any number of writers can use at once -- the main loop and interrupts can
+    // all log to the same port. owner_type is the same as for TXBuffer.
+    //
+    // A writer claims a private region with reserve() (all or nothing), fills it without holding
+    // any lock, and then calls commit(). The DMA is only given data up to where every claim so
+    // far has been committed: the claim offset and the number of open claims share one word, and
+    // whoever closes the last open claim publishes everything claimed up to then. So a writer
+    // never waits on another (an interrupt can't wait for the code it interrupted), and an
+    // interrupted writer simply holds back the ones that claimed after it until it commits.
+    //
+    // Offsets are packed into 16 bits, so _size is limited to 64KiB.
+    template <uint32_t _size, typename owner_type, typename base_type = char, typename index_t = BufferIndexType<_size>>
+    struct MPTXBuffer : BufferStats<MOTATE_CONFIG_BUFFER_STATS> {
+        static_assert(((_size-1)&_size)==0, "MPTXBuffer size must be 2^N");
+        static_assert(_size <= 0x10000UL, "MPTXBuffer size must be 64KiB or less");
+
+        typedef index_t index_type;              // offsets and lengths
+        typedef BufferSizeType<_size> size_type; // counts, as from available()
+
+        static constexpr uint32_t _max_transfer_size = 0xFFFF;
+
+        static constexpr uint32_t _claim_offset_mask = 0xFFFF;
+        static constexpr uint32_t _claim_count_one   = 0x10000;
+
+        owner_type _owner;
+
+        // Internal properties!
+        base_type _data[_size];
+
+        _BufferCASWord<uint32_t> _claims;          // (open claims << 16) | offset of the next claim
+        _BufferCASWord<uint32_t> _committed;       // everything before this offset can be sent
+        _BufferCASWord<uint32_t> _restart_lock;    // non-zero while someone is in _restartTransfer()
+        _BufferCASWord<uint32_t> _restart_pending; // someone wanted _restartTransfer() while it was locked
+
+        _BufferCASWord<uint32_t> _transfer_requested; // Non-zero means a transfer is active.
+
+        constexpr size_type size() { return _size; };
+
+        MPTXBuffer(owner_type owner) : _owner(owner) {};
+
+        void init() {
+            _owner->setTXTransferDoneCallback([&]() { // use a closure
+                _transfer_requested.store(0);
+                _restartTransfer();
+            });
+        };
+
+        bool isLocked() { return false; }
+
+        // Where the DMA is reading (not cached -- any writer may ask at any time)
+        index_t _getReadOffset() {
+            base_type* pos = _owner->getTXTransferPosition();
+            if (pos==nullptr) {
+                return 0;
+            }
+            return (pos - _data) & (_size-1); // if it's one past the end, we want it to become zero
+        };
+
+        bool isEmpty() {
+            return _getReadOffset() == (_committed.load() & _claim_offset_mask);
+        };
+
+        // Free space, as of now.
+        size_type available() {
+            return (_getReadOffset() - (_claims.load() & _claim_offset_mask) - 1)&(_size-1);
+        };
+
+        // Claim length values, starting at start. Returns false (and claims nothing) if there isn't room.
+        // Every successful reserve() must be followed by a commit(), and soon: later writers'
+        // data isn't sent until it is.
+        bool reserve(const index_t length, index_t &start) {
+            uint32_t claims = _claims.load();
+            uint32_t new_claims;
+            do {
+                start = claims & _claim_offset_mask;
+                index_t free_space = (_getReadOffset() - start - 1)&(_size-1);
+                if ((length == 0) || (length > free_space)) {
+                    _recordDropped(length);
+                    return false;
+                }
+                new_claims = ((claims & ~_claim_offset_mask) + _claim_count_one) | ((start + length)&(_size-1));
+            } while (!_claims.cas(claims, new_claims));
+            return true;
+        };
+
+        // Copy length values into a claimed region (from reserve) at offset (from its start).
+        void fill(const index_t start, const index_t offset, const base_type *src, const index_t length) {
+            index_t pos = (start + offset)&(_size-1);
+            index_t first = _size - pos;
+            if (first > length) {
+                first = length;
+            }
+            std::memcpy(_data + pos, src, first * sizeof(base_type));
+            if (first < length) {
+                std::memcpy(_data, src + first, (length - first) * sizeof(base_type));
+            }
+        };
+
+        // Direct access to a claimed value
+        base_type &at(const index_t start, const index_t offset) {
+            return _data[(start + offset)&(_size-1)];
+        };
+
+        // Close a claim. The last one out publishes everything claimed so far.
+        void commit() {
+            uint32_t claims = _claims.load();
+            uint32_t new_claims;
+            do {
+                new_claims = claims - _claim_count_one;
+            } while (!_claims.cas(claims, new_claims));
+
+            if ((new_claims & ~_claim_offset_mask) == 0) {
+                _recordFill((new_claims - _getReadOffset())&(_size-1));
+                _publish(new_claims & _claim_offset_mask);
+                _restartTransfer();
+            }
+        };
+
+        // Move _committed forward to target, unless someone (who interrupted us) already moved it further.
+        void _publish(const index_t target) {
+            uint32_t committed = _committed.load();
+            do {
+                index_t read_offset = _getReadOffset();
+                if (((committed - read_offset)&(_size-1)) >= ((target - read_offset)&(_size-1))) {
+                    return;
+                }
+            } while (!_committed.cas(committed, target));
+        };
+
+        void _restartTransfer() {
+            _recordRestart();
+            // Flag first, then try the lock: if whoever has it clears the flag after we set it,
+            // they see everything we committed before it, and if they don't, they go around again.
+            _restart_pending.store(1);
+            uint32_t unlocked = 0;
+            if (!_restart_lock.cas(unlocked, 1)) {
+                return;
+            }
+
+            do {
+                _restart_pending.store(0);
+
+                if (_transfer_requested.load() == 0) {
+                    index_t read_offset = _getReadOffset();
+                    index_t committed = _committed.load();
+
+                    if (read_offset != committed) {
+                        size_type transfer_size;
+                        if (read_offset > committed) {
+                            transfer_size = _size - read_offset;
+                        } else {
+                            transfer_size = committed - read_offset;
+                        }
+
+                        if ((uint32_t)transfer_size > _max_transfer_size) {
+                            transfer_size = _max_transfer_size;
+                        }
+
+                        _transfer_requested.store(transfer_size);
+
+                        // Make sure the data is out of the write buffer before the DMA goes looking for it
+                        _releaseFence();
+                        if (!_owner->startTXTransfer(_data + read_offset, transfer_size)) {
+                            _transfer_requested.store(0);
+                        } else {
+                            _recordTransfer(transfer_size);
+                        }
+                    }
+                }
+
+                _restart_lock.store(0);
+                unlocked = 0;
+            } while (_restart_pending.load() && _restart_lock.cas(unlocked, 1));
+        };
+
+        // non-blocking, all-or-nothing write -- safe from an interrupt. Returns write_size, or 0
+        // if it didn't fit.
+        size_t write_nb(const base_type *buffer, const index_t write_size) {
+            index_t start;
+            if (!reserve(write_size, start)) {
+                return 0;
+            }
+            fill(start, 0, buffer, write_size);
+            commit();
+            return write_size;
+        };
+
+        // BLOCKING write -- NOT for use in an interrupt (the DMA may need that interrupt to finish).
+        // Returns write_size, or 0 if it never could fit.
+        size_t write(const base_type *buffer, const index_t write_size) {
+            uint32_t blocked_start = _blockedStart();
+            bool blocked = false;
+            while (write_nb(buffer, write_size) == 0) {
+                if ((write_size == 0) || (write_size >= _size)) {
+                    return 0; // it'll never fit
+                }
+                _restartTransfer();
+                blocked = true;
+            }
+            if (blocked) {
+                _recordBlocked(blocked_start);
+            }
+            return write_size;
+        };
+    }; // MPTXBuffer
 } // namespace Motate
 
 #endif /* end of include guard: MOTATEBUFFER_H_ONCE */
\ No newline at end of file
@@ -31,6 +31,12 @@
 #define MOTATESPI_H_ONCE
 
 #include <cinttypes>
+#include <cstddef>
+#include <new>         // for placement new
+#include <type_traits>
+#include <utility>
+
+#include "MotateBuffer.h" // for _BufferCASWord
 
 
 /* After some setup, we call the processor-specific bits, then we have the
@@ -134,6 +140,66 @@ namespace Motate {
     };
 
 
+    // A callback that never allocates, for the SPI interrupt path: the callable (a lambda, functor,
+    // or function pointer) is kept inline, in _storage_size bytes, and called through one plain
+    // function pointer. It has to fit (checked at compile time), and must be trivially copyable
+    // and destructible -- so capture pointers and references (such as [&] or [this]), not objects
+    // that own memory. An empty one is false, and must not be called.
+    template <typename signature, std::size_t _storage_size = 4 * sizeof(void *)>
+    struct SPICallback;
+
+    template <typename return_t, typename... args_t, std::size_t _storage_size>
+    struct SPICallback<return_t(args_t...), _storage_size> {
+        typedef return_t (*invoker_t)(const void *, args_t...);
+
+        alignas(void *) unsigned char _storage[_storage_size];
+        invoker_t _invoker = nullptr;
+
+        SPICallback() {};
+        SPICallback(std::nullptr_t) {};
+
+        template <typename callable_t, typename = typename std::enable_if<
+            !std::is_same<typename std::decay<callable_t>::type, SPICallback>::value &&
+            !std::is_same<typename std::decay<callable_t>::type, std::nullptr_t>::value>::type>
+        SPICallback(callable_t &&callable) {
+            _assign(std::forward<callable_t>(callable));
+        };
+
+        template <typename callable_t, typename = typename std::enable_if<
+            !std::is_same<typename std::decay<callable_t>::type, SPICallback>::value &&
+            !std::is_same<typename std::decay<callable_t>::type, std::nullptr_t>::value>::type>
+        SPICallback &operator=(callable_t &&callable) {
+            _assign(std::forward<callable_t>(callable));
+            return *this;
+        };
+
+        SPICallback &operator=(std::nullptr_t) {
+            _invoker = nullptr;
+            return *this;
+        };
+
+        template <typename callable_t>
+        void _assign(callable_t &&callable) {
+            typedef typename std::decay<callable_t>::type stored_t;
+            static_assert(sizeof(stored_t) <= _storage_size, "SPICallback: the callable (its captures) is too large for the storage");
+            static_assert(alignof(stored_t) <= alignof(void *), "SPICallback: the callable needs more alignment than the storage has");
+            static_assert(std::is_trivially_copyable<stored_t>::value && std::is_trivially_destructible<stored_t>::value,
+                          "SPICallback: the callable must be trivially copyable and destructible (capture pointers or references)");
+
+            new (_storage) stored_t(std::forward<callable_t>(callable));
+            _invoker = [](const void *storage, args_t... args) -> return_t {
+                return (*const_cast<stored_t *>(static_cast<const stored_t *>(storage)))(std::forward<args_t>(args)...);
+            };
+        };
+
+        explicit operator bool() const { return _invoker != nullptr; };
+
+        return_t operator()(args_t... args) const {
+            return _invoker(_storage, std::forward<args_t>(args)...);
+        };
+    };
+
+
 } // namespace Motate
 
 #ifdef __AVR_XMEGA__
@@ -175,22 +241,117 @@ namespace Motate {
      **************************************************/
 
     struct SPIMessage;
+    struct SPIPeriodicJobBase;
+
+    // Devices with messages waiting are served highest priority first, and round-robin within a
+    // priority. A transaction that's underway isn't interrupted, unless the device holding the bus
+    // was marked preemptible -- then a higher priority device can take over between messages that
+    // deassert chip select, and the preempted device picks up where it left off afterward.
+    enum SPIPriority : uint8_t {
+        kSPIPriorityHighest = 0,
+        kSPIPriorityHigh    = 1,
+        kSPIPriorityNormal  = 2,
+        kSPIPriorityLow     = 3,
+    };
+    static constexpr uint8_t kSPIPriorityLevels = 4;
+
+    // Optional bus statistics, to see how long each priority waits for the bus.
+    // Build with MOTATE_CONFIG_SPI_STATS=1 (in USER_DEFINES) and set a clock with setSPIClock().
+    // When they're off, they take no space and no time, and the query functions return zero.
+    //
+    //   worstWait(priority)   - the longest a message of that priority waited, from being queued
+    //                           to starting to send, in units of the clock
+    //   messagesSent(priority) - how many messages of that priority were sent
+    //   preemptions()         - transactions set aside for a higher priority device
+#ifndef MOTATE_CONFIG_SPI_STATS
+#define MOTATE_CONFIG_SPI_STATS 0
+#endif
+
+    // One clock shared by all SPI buses, such as []{ return SysTickTimer.getValue(); }
+    // (or a cycle counter, since the waits are often shorter than a millisecond)
+    inline uint32_t (*&_spiClock())() {
+        static uint32_t (*clock)() = nullptr;
+        return clock;
+    };
+    inline void setSPIClock(uint32_t (*clock)()) { _spiClock() = clock; };
+    inline uint32_t _spiTime() { return _spiClock() ? _spiClock()() : 0; };
+
+    template <bool enabled>
+    struct SPIMessageStats {
+        void _stampQueued() {};
+        uint32_t _queuedTime() const { return 0; };
+    };
+
+    template <>
+    struct SPIMessageStats<true> {
+        uint32_t _queued_time = 0;
+
+        void _stampQueued() { _queued_time = _spiTime(); };
+        uint32_t _queuedTime() const { return _queued_time; };
+    };
+
+    template <bool enabled>
+    struct SPIBusStats {
+        void _recordSent(const uint8_t, const uint32_t) {};
+        void _recordPreemption() {};
+
+        uint32_t worstWait(const uint8_t) const { return 0; };
+        uint32_t messagesSent(const uint8_t) const { return 0; };
+        uint32_t preemptions() const { return 0; };
+        void resetStats() {};
+    };
+
+    template <>
+    struct SPIBusStats<true> {
+        volatile uint32_t _worst_wait[kSPIPriorityLevels] = {};
+        volatile uint32_t _messages_sent[kSPIPriorityLevels] = {};
+        volatile uint32_t _preemptions = 0;
+
+        void _recordSent(const uint8_t priority, const uint32_t queued_time) {
+            uint32_t wait = _spiTime() - queued_time;
+            if (wait > _worst_wait[priority]) { _worst_wait[priority] = wait; }
+            _messages_sent[priority]++;
+        };
+        void _recordPreemption() { _preemptions++; };
+
+        uint32_t worstWait(const uint8_t priority) const { return _worst_wait[priority]; };
+        uint32_t messagesSent(const uint8_t priority) const { return _messages_sent[priority]; };
+        uint32_t preemptions() const { return _preemptions; };
+        void resetStats() {
+            for (uint8_t i = 0; i < kSPIPriorityLevels; i++) { _worst_wait[i] = 0; _messages_sent[i] = 0; }
+            _preemptions = 0;
+        };
+    };
 
     struct SPIBusDeviceBase
     {
         // store a link to the next device on the bus (maintained by the Bus)
         SPIBusDeviceBase *_next_device = 0;
 
+        // this device's queued messages, oldest first (the first one may be sending)
+        SPIMessage *_first_message = nullptr;
+        SPIMessage *_last_message = nullptr;
+
+        // link in the bus's list of devices waiting for a turn (maintained by the Bus)
+        SPIBusDeviceBase *_next_ready_device = nullptr;
+        bool _ready = false;
+
+        // see SPIPriority
+        uint8_t _priority = kSPIPriorityNormal;
+        bool _preemptible = false;
+
         // set device options
         virtual void setOptions(const uint32_t baud, const uint16_t options, uint32_t min_between_cs_delay_ns, uint32_t cs_to_sck_delay_ns, uint32_t between_word_delay_ns) {};
         // queue message
         virtual void queueMessage(SPIMessage *msg) {};
+        // one of this device's jobs was triggered, so have the bus's interrupt queue it
+        virtual void _jobTriggered(SPIPeriodicJobBase *job) {};
         // return a value that can be used by hardware to select this device
         virtual uint32_t getChannel() { return 0; };
     };
 
     // useful verbose enums
-    struct SPIMessage
+    struct SPIMessage : SPIMessageStats<MOTATE_CONFIG_SPI_STATS>
     {
         enum {
             RemainAsserted = false,
@@ -212,7 +373,7 @@ namespace Motate {
         SPIBusDeviceBase *device;
         SPIMessage *next_message;
 
-        std::function<void(void)> message_done_callback;
+        SPICallback<void(void)> message_done_callback;
         volatile bool sending = false;
 
 
@@ -231,6 +392,120 @@ namespace Motate {
         }
     };
 
+#pragma mark SPIPeriodicJob
+    /**************************************************
+     *
+     * SPI Periodic Job: the same message, sent over and over on a timer
+     *
+     **************************************************/
+
+    // For polling a sensor or driver status at a fixed rate. The command is set up once, then each
+    // trigger() has it sent without the application doing anything, and each reply lands in one
+    // half of a double buffer. The application reads the latest complete reply with read(), which
+    // never blocks or locks out the interrupts -- it just tries again if a reply finished while it
+    // was copying.
+    //
+    // Call trigger() from a timer interrupt, for example:
+    //
+    //   Timer<kEncoderTimerNum> encoderTimer {kTimerUpToMatch, 10000 /* Hz */};
+    //   SPIPeriodicJob<4> encoderJob;
+    //
+    //   void setup() {
+    //       encoderJob.init(&encoderDevice, encoderReadCommand);
+    //       encoderTimer.setInterrupts(kInterruptOnOverflow | kInterruptPriorityLow);
+    //       encoderTimer.start();
+    //   }
+    //
+    //   MOTATE_TIMER_INTERRUPT(kEncoderTimerNum) {
+    //       int16_t channel;
+    //       if (getInterruptCause(channel) == kInterruptOnOverflow) {
+    //           encoderJob.trigger();
+    //       }
+    //   }
+    //
+    // trigger() doesn't touch the bus itself: it puts the job on the bus's list of triggered
+    // jobs and pends the SPI interrupt, and that does the queueing. So the timer interrupt can
+    // have any priority, and can come in the middle of the main loop queueing a message.
+    struct SPIPeriodicJobBase
+    {
+        SPIPeriodicJobBase *_next_triggered = nullptr; // link in the bus's list of triggered jobs (maintained by the bus)
+
+        // from the SPI interrupt: queue the message
+        virtual void _queueTriggered() {};
+    };
+
+    template <uint16_t _size>
+    struct SPIPeriodicJob : SPIPeriodicJobBase
+    {
+        uint8_t _tx_buffer[_size];
+        uint8_t _rx_buffer[2][_size];
+
+        SPIMessage _message;
+        SPIBusDeviceBase *_device = nullptr;
+
+        volatile uint8_t _ready_index = 0;  // which _rx_buffer has the latest complete reply
+        volatile uint32_t _sequence = 0;    // replies completed so far
+        volatile uint32_t _skipped = 0;     // triggers that came while the last one was still going
+        volatile bool _in_flight = false;
+
+        constexpr uint16_t size() const { return _size; };
+
+        // Set the device and the command to send (size() values), and clear the replies.
+        // Call it once, before anything can call trigger().
+        void init(SPIBusDeviceBase *device, const uint8_t *command) {
+            _device = device;
+            for (uint16_t i = 0; i < _size; i++) {
+                _tx_buffer[i] = command[i];
+                _rx_buffer[0][i] = 0;
+                _rx_buffer[1][i] = 0;
+            }
+            _message.message_done_callback = [&]() {
+                // the reply is complete, so it becomes the one to read
+                _ready_index = _ready_index ^ 1;
+                __asm__ __volatile__ ("" ::: "memory");
+                _sequence = _sequence + 1;
+                _in_flight = false;
+            };
+        };
+
+        // Have the command queued, with the reply going into the half that isn't being read.
+        // If the last one hasn't finished yet this one is skipped (and counted).
+        void trigger() {
+            if (_in_flight || (_device == nullptr)) {
+                _skipped = _skipped + 1;
+                return;
+            }
+            _in_flight = true;
+            _device->_jobTriggered(this);
+        };
+
+        void _queueTriggered() override {
+            _message.setup(_tx_buffer, _rx_buffer[_ready_index ^ 1], _size, SPIMessage::DeassertAfter, SPIMessage::EndTransaction);
+            _device->queueMessage(&_message);
+        };
+
+        // Copy the latest complete reply into buffer (size() values), and return which reply it
+        // was (0 if there hasn't been one yet).
+        uint32_t read(uint8_t *buffer) {
+            uint32_t sequence;
+            do {
+                sequence = _sequence;
+                __asm__ __volatile__ ("" ::: "memory");
+                const uint8_t *reply = _rx_buffer[_ready_index];
+                for (uint16_t i = 0; i < _size; i++) {
+                    buffer[i] = reply[i];
+                }
+                __asm__ __volatile__ ("" ::: "memory");
+                // if a reply finished while we were copying, the next trigger may be writing over
+                // the half we just read, so go again
+            } while (sequence != _sequence);
+            return sequence;
+        };
+
+        uint32_t sequence() const { return _sequence; };
+        uint32_t skipped() const { return _skipped; };
+    };
+
     // attach device to spi bus
 
 #pragma mark SPIBus
@@ -241,7 +516,7 @@ namespace Motate {
      **************************************************/
 
     template<pin_number spiMISOPinNumber, pin_number spiMOSIPinNumber, pin_number spiSCKPinNumber>
-    struct SPIBus
+    struct SPIBus : SPIBusStats<MOTATE_CONFIG_SPI_STATS>
     {
 
         static_assert(IsSPIMISOPin<spiMISOPinNumber>(),
@@ -265,10 +540,34 @@ namespace Motate {
         SPIGetHardware<spiMISOPinNumber, spiMOSIPinNumber, spiSCKPinNumber> hardware;
 
         SPIBusDeviceBase *_first_device, *_current_transaction_device;
-        SPIMessage *_first_message;//, *_last_message;
+
+        // Each device keeps its own FIFO of messages. Devices with messages waiting, other than the
+        // one holding the bus, wait their turn in the ready list for their priority -- also a FIFO,
+        // so the bus goes round-robin a transaction at a time within a priority. A bit is set in
+        // _ready_priorities for each list that isn't empty. Queueing and picking the next message
+        // are both O(1).
+        SPIBusDeviceBase *_first_ready_device[kSPIPriorityLevels] = {};
+        SPIBusDeviceBase *_last_ready_device[kSPIPriorityLevels] = {};
+        uint8_t _ready_priorities = 0;
+
+        // set when the last message deasserted and left the transaction open on a preemptible device
+        bool _at_preemption_point = false;
+
+        SPIMessage *_current_message = nullptr;
+
+        // The message queued in the hardware behind _current_message, to go out with no gap (if any)
+        SPIMessage *_chained_message = nullptr;
+
+        // What the callback of a message with another chained behind it asked for, held until that
+        // one is done as well (it's already out, in the same transaction)
+        bool _held_ends_transaction = false;
+        bool _held_deassert_after = false;
 
         volatile bool sending = false; // as long as this is true, sendNextMessage() does nothing
 
+        // SPIPeriodicJobs waiting for the interrupt to queue them, most recently triggered first
+        _BufferCASWord<SPIPeriodicJobBase *> _triggered_jobs;
+
         SPIBus() : hardware{} {
             hardware.init();
         }
@@ -291,6 +590,11 @@ namespace Motate {
         }
 
         void removeDevice(SPIBusDeviceBase *old) {
+            if (old->_ready) {
+                // it was waiting for a turn, so take it out of line
+                _removeReadyDevice(old);
+            }
+
             if (_first_device == nullptr) {return;}
 
             if (_first_device == old) {
@@ -324,46 +628,237 @@ namespace Motate {
             hardware.enable();
         };
 
+        // Put device at the back of the line for its priority (or the front, to resume a preempted
+        // transaction). It must not already be in line.
+        void _pushReadyDevice(SPIBusDeviceBase *device, const bool at_front = false) {
+            const uint8_t priority = device->_priority;
+            device->_ready = true;
+            if (_last_ready_device[priority] == nullptr) {
+                device->_next_ready_device = nullptr;
+                _first_ready_device[priority] = device;
+                _last_ready_device[priority] = device;
+            } else if (at_front) {
+                device->_next_ready_device = _first_ready_device[priority];
+                _first_ready_device[priority] = device;
+            } else {
+                device->_next_ready_device = nullptr;
+                _last_ready_device[priority]->_next_ready_device = device;
+                _last_ready_device[priority] = device;
+            }
+            _ready_priorities |= (1 << priority);
+        }
+
+        // Take the first device from the highest priority line that has one
+        SPIBusDeviceBase *_popReadyDevice() {
+            if (_ready_priorities == 0) {
+                return nullptr;
+            }
+            const uint8_t priority = __builtin_ctz(_ready_priorities);
+
+            SPIBusDeviceBase *device = _first_ready_device[priority];
+            _first_ready_device[priority] = device->_next_ready_device;
+            if (_first_ready_device[priority] == nullptr) {
+                _last_ready_device[priority] = nullptr;
+                _ready_priorities &= ~(1 << priority);
+            }
+            device->_next_ready_device = nullptr;
+            device->_ready = false;
+            return device;
+        }
+
+        // Take device out of line from wherever it is (this walks the line)
+        void _removeReadyDevice(SPIBusDeviceBase *device) {
+            const uint8_t priority = device->_priority;
+            SPIBusDeviceBase *previous = nullptr;
+            SPIBusDeviceBase *walker = _first_ready_device[priority];
+            while ((walker != nullptr) && (walker != device)) {
+                previous = walker;
+                walker = walker->_next_ready_device;
+            }
+            if (walker == nullptr) {
+                return;
+            }
+            if (previous == nullptr) {
+                _first_ready_device[priority] = device->_next_ready_device;
+            } else {
+                previous->_next_ready_device = device->_next_ready_device;
+            }
+            if (_last_ready_device[priority] == device) {
+                _last_ready_device[priority] = previous;
+            }
+            if (_first_ready_device[priority] == nullptr) {
+                _ready_priorities &= ~(1 << priority);
+            }
+            device->_next_ready_device = nullptr;
+            device->_ready = false;
+        }
+
+        void _setDevicePriority(SPIBusDeviceBase *device, const uint8_t priority, const bool preemptible) {
+            device->_preemptible = preemptible;
+            if (device->_ready) {
+                // it's waiting in line, so move it to the other line
+                hardware._setInterruptMasked(true);
+                _removeReadyDevice(device);
+                device->_priority = priority;
+                _pushReadyDevice(device);
+                hardware._setInterruptMasked(false);
+            } else {
+                device->_priority = priority;
+            }
+        }
+
+        bool _higherPriorityReady(const uint8_t priority) {
+            return (_ready_priorities & ((1 << priority) - 1)) != 0;
+        }
+
+        // Called (by the device) after a message was added to device's queue
+        void _messageQueued(SPIBusDeviceBase *device) {
+            // The device holding the bus isn't in the ready list, and one already in it keeps its place
+            if (!device->_ready && (device != _current_transaction_device)) {
+                _pushReadyDevice(device);
+            }
+        }
+
+        // If the device's next message can follow the one being sent on the same chip select,
+        // hand it to the hardware now, so the SPI clock keeps running from one to the next.
+        // That's only when the sending message keeps the transaction open and stays asserted --
+        // and since the next one is already on its way when the first one's callback is called,
+        // changing the immediate_* values from that callback won't take effect until after it.
+        // Like sendNextMessage(), call it from the interrupt or with the interrupt masked.
+        void _chainNextMessage() {
+            if (!hardware.canChainTransfers()) { return; }
+
+            SPIMessage *current_message = _current_message;
+            if ((current_message != nullptr) && (_chained_message == nullptr) &&
+                !current_message->deassert_after && !current_message->ends_transaction &&
+                (current_message->rx_buffer != nullptr) && (current_message->tx_buffer != nullptr))
+            {
+                SPIMessage *next_message = current_message->next_message;
+                if ((next_message != nullptr) && !next_message->sending &&
+                    hardware.startNextTransfer(next_message->tx_buffer, next_message->rx_buffer, next_message->size))
+                {
+                    next_message->sending = true;
+                    _chained_message = next_message;
+                    this->_recordSent(next_message->device->_priority, next_message->_queuedTime());
+                }
+            }
+        }
+
+        // Only from the SPI interrupt, or with it masked (as queueMessage() does), since the
+        // interrupt calls it too.
         void sendNextMessage() {
-            if (sending) { return; }
-            if (_first_message == nullptr) { return;}
-            if (_first_message->sending) { return; }
-
-            if (_current_transaction_device != nullptr) {
-                // the next message we send must be from the _current_transaction_device
-                if (!(_first_message->device == _current_transaction_device)) {
-                    // now we'll make a pass throught the messages, looking for one
-                    // for the _current_transaction_device
-                    SPIMessage *previous_message = _first_message;
-                    SPIMessage *walker_message = _first_message->next_message;
-
-                    while (walker_message != nullptr) {
-                        if (walker_message->device == _current_transaction_device) {
-                            // we have our actual next message, we'll pop it to the first position
-                            previous_message->next_message = walker_message->next_message;
-                            walker_message->next_message = _first_message;
-                            _first_message = walker_message;
-                            break;
-                        }
-
-                        previous_message = walker_message;
-                        walker_message = walker_message->next_message;
-                    }
-
-                    if (walker_message == nullptr) {
-                        // we have to wait for a new message to be queued up
-                        return;
-                    }
+            if (sending) {
+                // we might have just queued what can follow the message being sent
+                _chainNextMessage();
+                return;
+            }
+
+            if ((_current_transaction_device != nullptr) && _at_preemption_point &&
+                _higherPriorityReady(_current_transaction_device->_priority))
+            {
+                // set this transaction aside; it'll be first in line for its priority
+                if (!_current_transaction_device->_ready) {
+                    _pushReadyDevice(_current_transaction_device, /*at_front =*/ true);
                 }
+                _current_transaction_device = nullptr;
+                this->_recordPreemption();
             }
 
+            if (_current_transaction_device == nullptr) {
+                // the bus is free, so the next device in line gets it
+                _current_transaction_device = _popReadyDevice();
+                if (_current_transaction_device == nullptr) { return; }
+            }
+
+            // the next message we send must be from the _current_transaction_device
+            SPIMessage *next_message = _current_transaction_device->_first_message;
+            if (next_message == nullptr) {
+                // we have to wait for a new message to be queued up
+                return;
+            }
+            if (next_message->sending) { return; }
+
             sending = true;
-            _first_message->sending = true;
-            _current_transaction_device = _first_message->device;
+            _at_preemption_point = false;
+            next_message->sending = true;
+            _current_message = next_message;
+            this->_recordSent(_current_transaction_device->_priority, next_message->_queuedTime());
             hardware.setChannel(_current_transaction_device->getChannel());
-            hardware.startTransfer(_first_message->tx_buffer, _first_message->rx_buffer, _first_message->size);
+            hardware.startTransfer(next_message->tx_buffer, next_message->rx_buffer, next_message->size);
+
+            _chainNextMessage();
         }
 
+        // _current_message is done: pop it, call its callback, and deal with the transaction
+        void _finishMessage() {
+            // _current_message is done sending.
+            // Go ahead and pop it from its device's queue and reset (partially)
+            auto this_message = _current_message;
+            auto this_device = this_message->device;
+            _current_message = nullptr;
+            this_device->_first_message = this_message->next_message;
+            if (this_device->_first_message == nullptr) {
+                this_device->_last_message = nullptr;
+            }
+            this_message->next_message = nullptr;
+            this_message->sending = false;
+            _at_preemption_point = false;
+
+            // Set the values for *this* message before the callback, so
+            // the callback can re-queue with different values AND tell us
+            // how to handle the rest of this transaction. With these defaulted
+            // like this, the callback can do nothing and get the original
+            // behavior the message was configured for.
+            this_message->immediate_ends_transaction = this_message->ends_transaction;
+            this_message->immediate_deassert_after = this_message->deassert_after;
+
+            // Call the message's callback, if any, THEN check immediate_ends_transaction
+            // and immediate_deassert_after, since the callback might decide to change those.
+
+            // Ignore ends_transaction and deassert_after, since those are for the next queueing
+            // of the message - which may happen in the callback as well.
+
+            // IMPORTANT NOTE: the callback may call sendNextMessage(), so we
+            //   keep sending at true to prevent issues.
+
+            if (this_message->message_done_callback) {
+                this_message->message_done_callback();
+            }
+
+            if (_chained_message != nullptr) {
+                // The next message is already out behind this one, so ending the transaction or
+                // deasserting now would be under it. (Ending it here would also put the device back
+                // in line for a message that's about to be done, leaving it there with nothing to
+                // send.) They're done after that one instead.
+                _held_ends_transaction = this_message->immediate_ends_transaction;
+                _held_deassert_after = this_message->immediate_deassert_after;
+                return;
+            }
+            if (_held_ends_transaction) {
+                this_message->immediate_ends_transaction = true;
+            }
+            if (_held_deassert_after) {
+                this_message->immediate_deassert_after = true;
+            }
+            _held_ends_transaction = false;
+            _held_deassert_after = false;
+
+            if (this_message->immediate_ends_transaction) {
+                _current_transaction_device = nullptr;
+
+                // if it has more to send, it goes to the back of the line
+                if ((this_device->_first_message != nullptr) && !this_device->_ready) {
+                    _pushReadyDevice(this_device);
+                }
+            } else if (this_message->immediate_deassert_after && this_device->_preemptible) {
+                _at_preemption_point = true;
+            }
+
+            if (this_message->immediate_deassert_after) {
+                hardware.deassert();
+            }
+        };
+
         void spiInterruptHandler(uint16_t interruptCause) {
             if (interruptCause & SPIInterrupt::OnTxReady) {
                 // ready to transfer...
@@ -378,45 +873,61 @@ namespace Motate {
                 hardware._disableOnTXTransferDoneInterrupt();
                 hardware._disableOnRXTransferDoneInterrupt();
 
-                // _first_message is done sending.
-                // Go ahead and pop it from the list and reset (partially)
-                auto this_message = _first_message;
-                _first_message = _first_message->next_message;
-                this_message->next_message = nullptr;
-                this_message->sending = false;
-
-                // Set the values for *this* message before the callback, so
-                // the callback can re-queue with different values AND tell us
-                // how to handle the rest of this transaction. With these defaulted
-                // like this, the callback can do nothing and get the original
-                // behavior the message was configured for.
-                this_message->immediate_ends_transaction = this_message->ends_transaction;
-                this_message->immediate_deassert_after = this_message->deassert_after;
-
-                // Call the message's callback, if any, THEN check immediate_ends_transaction
-                // and immediate_deassert_after, since the callback might decide to change those.
-
-                // Ignore ends_transaction and deassert_after, since those are for the next queueing
-                // of the message - which may happen in the callback as well.
+                // If a message was chained behind the current one, both are done now. The first
+                // is finished while _chained_message is still set, so it knows.
+                SPIMessage *chained_message = _chained_message;
 
-                // IMPORTANT NOTE: the callback may call sendNextMessage(), so we
-                //   keep sending at true to prevent issues.
-
-                if (this_message->message_done_callback) {
-                    this_message->message_done_callback();
-                }
-
-                if (this_message->immediate_ends_transaction) {
-                    _current_transaction_device = nullptr;
-                }
-
-                if (this_message->immediate_deassert_after) {
-                    hardware.deassert();
+                _finishMessage();
+                if (chained_message != nullptr) {
+                    _chained_message = nullptr;
+                    _current_message = chained_message;
+                    _finishMessage();
                 }
 
                 sending = false; // we can now allow more sending
                 sendNextMessage();
             }
+
+            // SPIPeriodicJob::trigger() pends this interrupt to get here
+            _queueTriggeredJobs();
+        };
+
+        // Called (by a device, from a timer interrupt or wherever trigger() was) for SPIPeriodicJob.
+        // Triggers can come from interrupts of any priority, so job is pushed on the list with a
+        // compare-and-swap. (A job is only triggered again once its last reply is in, so it's
+        // never on the list twice.)
+        void _jobTriggered(SPIPeriodicJobBase *job) {
+            SPIPeriodicJobBase *first = _triggered_jobs.load();
+            do {
+                job->_next_triggered = first;
+            } while (!_triggered_jobs.cas(first, job));
+            hardware._setInterruptPending();
+        };
+
+        // From the interrupt: queue the jobs that were triggered, and only those, in the order
+        // they were triggered. The list is taken whole, so a trigger that comes during the walk
+        // starts a new one (and pends another pass).
+        void _queueTriggeredJobs() {
+            SPIPeriodicJobBase *job = _triggered_jobs.load();
+            if (job == nullptr) {
+                return;
+            }
+            while (!_triggered_jobs.cas(job, nullptr)) {}
+
+            // it was pushed newest first, so turn it around
+            SPIPeriodicJobBase *oldest = nullptr;
+            while (job != nullptr) {
+                SPIPeriodicJobBase *next = job->_next_triggered;
+                job->_next_triggered = oldest;
+                oldest = job;
+                job = next;
+            }
+            for (job = oldest; job != nullptr; ) {
+                SPIPeriodicJobBase *next = job->_next_triggered;
+                job->_next_triggered = nullptr;
+                job->_queueTriggered();
+                job = next;
+            }
         };
 
 
@@ -467,25 +978,29 @@ namespace Motate {
             };
 
             // queue message
+            // Higher priority devices get the bus first (see SPIPriority). A preemptible device
+            // can have the bus taken from it between messages that deassert chip select.
+            void setPriority(const uint8_t priority, const bool preemptible = false) {
+                _spi_bus->_setDevicePriority(this, priority, preemptible);
+            };
+
             void queueMessage (SPIMessage *msg) override {
                 msg->device = this;
-                if (_spi_bus->_first_message == nullptr) {
-                    _spi_bus->_first_message = msg;
-                    //_spi_bus->_last_message = msg;
+                msg->next_message = nullptr;
+                msg->_stampQueued();
+
+                // The interrupt pops from this same queue, may queue itself (from a callback, or for
+                // an SPIPeriodicJob), and calls sendNextMessage(), so hold it off until we're done.
+                // Only the main loop and the SPI interrupt may queue (see SPIPeriodicJob for timers).
+                _spi_bus->hardware._setInterruptMasked(true);
+                if (_last_message == nullptr) {
+                    _first_message = msg;
                 }
                 else {
-//                    _spi_bus->_last_message->next_message = msg;
-//                    _spi_bus->_last_message = msg;
-                    SPIMessage *previous_message = _spi_bus->_first_message;
-                    SPIMessage *walker_message = _spi_bus->_first_message->next_message;
-
-                    while (walker_message != nullptr) {
-                        previous_message = walker_message;
-                        walker_message = walker_message->next_message;
-                    }
-
-                    previous_message->next_message = msg;
+                    _last_message->next_message = msg;
                 }
+                _last_message = msg;
+                _spi_bus->_messageQueued(this);
 
                 // Either we just queued the first message, OR we *might* have
                 // just queued a message for the current transaction
@@ -493,8 +1008,11 @@ namespace Motate {
 
                 // In either case, we want to:
                 _spi_bus->sendNextMessage();
+                _spi_bus->hardware._setInterruptMasked(false);
             };
 
+            void _jobTriggered(SPIPeriodicJobBase *job) override { _spi_bus->_jobTriggered(job); };
+
             uint32_t getChannel() override { return _cs_value; };
         };
 
@@ -79,11 +79,14 @@ namespace Motate {
     BufferedUART<kSerial_RX, kSerial_TX, kSerial_RTS, kSerial_CTS> Serial {115200, UARTMode::RTSCTSFlowControl}; // 115200 is the default, as well.
 } // namespace Motate
 
+// The SAM UART hooks up its own CTS pin interrupt (see UART::ctsPin), the others need it passed on
+#if !(defined(__SAM4E8E__) || defined(__SAM4E16E__) || defined(__SAM4E8C__) || defined(__SAM4E16C__) || defined(__SAMS70N19__) || defined(__SAMS70N20__) || defined(__SAMS70N21__))
 namespace Motate {
 MOTATE_PIN_INTERRUPT(kSerial_CTS) {
     Motate::Serial.pinChangeInterrupt();
 }
 }
+#endif
 
 #endif //defined(__SAM3X8E__) || defined(__SAM3X8C__)
 
@@ -66,6 +66,14 @@ namespace Motate {
         static constexpr uint16_t RTSCTSFlowControl  = 1 << 5;
         static constexpr uint16_t XonXoffFlowControl = 1 << 6;
 
+        // Half-duplex RS-485: RTS drives the transceiver's driver enable, high while sending
+        // (USART only, and it must be the USART's own RTS pin). Overrides RTSCTSFlowControl.
+        static constexpr uint16_t RS485              = 1 << 7;
+
+        // 9-bit multidrop: the 9th (parity) bit marks address bytes, see UART::readFrame()
+        // (USART only). Overrides the parity options.
+        static constexpr uint16_t Multidrop          = 1 << 8;
+
         // TODO: Add polarity inversion and bit reversal options
     };
 
@@ -97,6 +105,16 @@ namespace Motate {
 
         /* These are for internal use only: */
         static constexpr uint16_t OnCTSChanged      = 1<<10;
+        static constexpr uint16_t OnRxIdle          = 1<<11;
+
+        /* Line errors: */
+        static constexpr uint16_t OnRxOverrun       = 1<<12;
+        static constexpr uint16_t OnRxFramingError  = 1<<13;
+        static constexpr uint16_t OnRxParityError   = 1<<14;
+        static constexpr uint16_t OnRxError         = OnRxOverrun | OnRxFramingError | OnRxParityError;
+
+        /* In multidrop mode, an address byte arrived (instead of OnRxParityError): */
+        static constexpr uint16_t OnRxAddress       = 1<<15;
         
     };
 } // namespace Motate
@@ -155,6 +173,8 @@ namespace Motate {
         std::function<void(bool)> connection_state_changed_callback;
         std::function<void(void)> transfer_rx_done_callback;
         std::function<void(void)> transfer_tx_done_callback;
+        std::function<void(void)> rx_idle_callback;
+        std::function<void(uint16_t)> rx_error_callback;
 
         Buffer<16> overflowBuffer;
 
@@ -171,9 +191,12 @@ namespace Motate {
                 this->uartInterruptHandler(interruptCause);
             });
             hardware.setInterrupts(kInterruptPriorityHigh); // enable interrupts and set the priority
-            if (!isRealAndCorrectRTSPin<rtsPinNumber, rxPinNumber>()) {
-                rtsPin = true; // active low
+            hardware._setInterruptRxError(true);
+            if (_multidrop) {
+                hardware._setInterruptRxOverrun(false); // see readFrame()
             }
+            _setSoftwareRTS(true); // active low
+            hardware.setRxIdleTimeout(_rxIdleTimeout());
             if (!isRealAndCorrectCTSPin<ctsPinNumber, rxPinNumber>()) {
                 ctsPin.setInterrupts(kInterruptPriorityHigh); // enable interrupts and set the priority
             }
@@ -181,6 +204,45 @@ namespace Motate {
 
         void setOptions(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
             hardware.setOptions(baud, options, fromConstructor);
+            _xonXoffFlowControl = (options & UARTMode::XonXoffFlowControl);
+            _rs485 = (options & UARTMode::RS485) && hardware.canRS485();
+            _multidrop = (options & UARTMode::Multidrop) && hardware.canMultidrop();
+            if (!_xonXoffFlowControl && (_tx_paused_by & kTXPausedByXOff)) {
+                _resumeTX(kTXPausedByXOff); // don't leave it stuck on an XOFF
+            }
+            if (!fromConstructor && !_reading) {
+                hardware.setRxIdleTimeout(_rxIdleTimeout());
+            }
+        };
+
+        // The baud actually achieved, which may be a little off from what was asked for
+        uint32_t getBaud() {
+            return hardware.getBaud();
+        };
+
+        // *** RS-485
+        // In RS485 mode the USART raises RTS (the driver enable) itself when it starts sending, and
+        // drops it turnaround_bit_times after the last stop bit, so DMA writes need nothing extra.
+        // The default turnaround is 0: release the bus as soon as the stop bit is out.
+        // With the receiver enable tied to the driver enable, we don't hear our own writes.
+        bool _rs485 = false;
+
+        bool setRS485Turnaround(const uint8_t turnaround_bit_times) {
+            return hardware.setRS485Turnaround(turnaround_bit_times);
+        };
+
+        // Catching bytes between transfers in the overflow buffer is an interrupt per byte, which in
+        // multidrop mode would be for every byte on the bus. There, bytes outside of a frame are ignored.
+        void _setInterruptRxReady(const bool value) {
+            hardware.setInterruptRxReady(value && !_multidrop);
+        };
+
+        // Software RTS (flow control) is only for when RTS isn't the USART's own pin, and not for
+        // RS-485, where RTS is the driver enable.
+        void _setSoftwareRTS(const bool value) {
+            if (!isRealAndCorrectRTSPin<rtsPinNumber, rxPinNumber>() && !_rs485) {
+                rtsPin = value;
+            }
         };
 
         bool isConnected() {
@@ -196,6 +258,7 @@ namespace Motate {
         };
 
         // WARNING: Currently only reads in bytes. For more-that-byte size data, we'll need another call.
+        // BLOCKING!! See the asynchronous read() below.
         int16_t read(const uint8_t *buffer, const uint16_t length) {
             int16_t total_read = 0;
             int16_t to_read = length;
@@ -215,7 +278,12 @@ namespace Motate {
             return total_read;
         };
 
+        // Waits for any DMA write (see write() below) to finish first, so the byte goes out after
+        // it rather than in the middle of it.
         int16_t writeByte(uint8_t data) {
+            while (_writing) {
+                ;
+            }
             hardware.flush();
             return hardware.writeByte(data);
         };
@@ -229,65 +297,527 @@ namespace Motate {
             hardware.flushRead();
         };
 
+        // *** DMA writes
+        // These hand whole spans to the TX DMA (PDC or XDMAC) instead of feeding the USART one
+        // byte at a time. Only one write can be in progress, and not while a TXBuffer is using
+        // the port.
+        //
+        // write(data, length, autoFlush) is BLOCKING, as it always was: it waits for any write
+        // already in progress, then for its own to finish, so data can be reused (or go out of
+        // scope) as soon as it returns. It needs the TX interrupt to finish, so don't call it
+        // from an interrupt.
+        //
+        // write(data, length, done) is the asynchronous one: it returns as soon as the DMA has
+        // started (or 0 if a write is already in progress), and done is called from the
+        // interrupt once it's all gone to the USART. The DMA reads the data straight from where
+        // it is, so it must stay valid and unchanged until then -- not a stack buffer that goes
+        // out of scope first.
+        //
+        // The DMA counters are 16 bits, so longer writes go out in chunks of up to
+        // _max_write_chunk, each started from the interrupt as the one before it ends.
+
+        static constexpr uint16_t _max_write_chunk = 0xFFFF;
+
+        volatile bool _writing = false;
+        std::function<bool(void)> _write_continue;    // starts the next span, or returns false if there is none
+        std::function<void(void)> _write_done_callback;
+
+        const char *_write_next = nullptr;            // the rest of a write longer than one chunk
+        size_t _write_remaining = 0;
+
+        bool _startWrite(const char* data, const uint16_t length) {
+            _writing = true;
+            if (!hardware.startTXTransfer(const_cast<char *>(data), length)) {
+                _writing = false;
+                return false;
+            }
+            return true;
+        };
+
+        bool isWriting() { return _writing; };
+
+        // Starts the next chunk of _write_next. The position is moved on first, since the
+        // interrupt for a short chunk could come before _startWrite() returns.
+        bool _writeNextChunk() {
+            if (_write_remaining == 0) {
+                return false;
+            }
+            uint16_t chunk = (_write_remaining > _max_write_chunk) ? _max_write_chunk : _write_remaining;
+            const char *chunk_start = _write_next;
+            _write_next += chunk;
+            _write_remaining -= chunk;
+            if (!_startWrite(chunk_start, chunk)) {
+                _write_next = chunk_start;
+                _write_remaining += chunk;
+                return false;
+            }
+            return true;
+        };
+
+        bool _startChunkedWrite(const char* data, const size_t length) {
+            _write_next = data;
+            _write_remaining = length;
+            _write_continue = nullptr;
+            if (length > _max_write_chunk) {
+                _write_continue = [this]() -> bool { // use a closure
+                    return _writeNextChunk();
+                };
+            }
+            if (!_writeNextChunk()) {
+                _write_continue = nullptr;
+                return false;
+            }
+            return true;
+        };
+
         // WARNING: Currently only writes in bytes. For more-that-byte size data, we'll need another call.
-        int16_t write(const char* data, const uint16_t length = 0, bool autoFlush = false) {
-            int16_t total_written = 0;
-            const char* out_ptr = data;
-            int16_t to_write = length;
+        // A length of 0 means data is a null-terminated string. Returns the length, once it has
+        // all gone to the USART. With autoFlush, it also waits for the USART to send it.
+        size_t write(const char* data, const size_t length = 0, bool autoFlush = false) {
+            size_t to_write = length ? length : strlen(data);
+            if (to_write == 0) {
+                return 0;
+            }
+
+            while (_writing || !_startChunkedWrite(data, to_write)) {
+                ;
+            }
+            while (_writing) {
+                ;
+            }
+
+            if (autoFlush) {
+                flush();
+            }
 
-            if (length==0 && *out_ptr==0) {
+            return to_write;
+        };
+
+        // Asynchronous: returns the length once the write has started, or 0 if another is in
+        // progress. done is called (from the interrupt) once the data has all gone to the USART,
+        // and until then data must be left alone.
+        size_t write(const char* data, const size_t length, std::function<void(void)> &&done) {
+            size_t to_write = length ? length : strlen(data);
+            if (to_write == 0 || _writing) {
                 return 0;
             }
 
-            do {
-                int16_t ret = hardware.writeByte(*out_ptr);
+            _write_done_callback = std::move(done);
+            if (!_startChunkedWrite(data, to_write)) {
+                _write_done_callback = nullptr;
+                return 0;
+            }
+            return to_write;
+        };
 
-                if (ret > 0) {
-                    out_ptr++;
-                    total_written++;
-                    to_write--;
+        // Sends up to length values (0 for all of them) of what's in data now, a span at a time,
+        // consuming each span once the DMA is done with it. The spans stay in data until then, so
+        // an interrupt may keep adding to it. BLOCKING, like write() above. Returns how many
+        // values were sent (both spans, if they wrapped), or 0 if data was empty.
+        template<uint32_t _size>
+        size_t write(Motate::Buffer<_size> &data, const size_t length = 0, bool autoFlush = false) {
+            while (_writing) {
+                ;
+            }
 
-                    if (length==0 && *out_ptr==0) {
-                        break;
-                    }
-                } else if (autoFlush) {
-                    flush();
-                } else {
-                    break;
-                }
-            } while (to_write);
+            size_t to_write = data.size() - data.available();
+            if (length && (length < to_write)) {
+                to_write = length;
+            }
+            if (to_write == 0) {
+                return 0;
+            }
+
+            _buffer_write_remaining = to_write;
+            _write_continue = [this, &data]() -> bool { // use a closure
+                data.consume(_buffer_write_span);
+                _buffer_write_remaining -= _buffer_write_span;
+                return _writeBufferSpan(data);
+            };
 
-            if (autoFlush && total_written > 0)
+            while (!_writeBufferSpan(data)) {
+                ;
+            }
+            while (_writing) {
+                ;
+            }
+
+            if (autoFlush) {
                 flush();
+            }
 
-            return total_written;
+            return to_write;
         };
 
-        template<uint16_t _size>
-        int16_t write(Motate::Buffer<_size> &data, const uint16_t length = 0, bool autoFlush = false) {
-            int16_t total_written = 0;
-            int16_t to_write = length;
+        size_t _buffer_write_remaining = 0;
+        uint16_t _buffer_write_span = 0;
 
-            do {
-                int16_t value = data.peek();
-                if (value < 0) // no more data
-                    break;
+        template<uint32_t _size>
+        bool _writeBufferSpan(Motate::Buffer<_size> &data) {
+            typename Motate::Buffer<_size>::index_type span_length;
+            const char *span = data.readSpan(span_length);
+            size_t to_write = span_length;
+            if (to_write > _buffer_write_remaining) {
+                to_write = _buffer_write_remaining;
+            }
+            if (to_write > _max_write_chunk) {
+                to_write = _max_write_chunk;
+            }
+            if (to_write == 0) {
+                return false;
+            }
+            _buffer_write_span = to_write;
+            return _startWrite(span, to_write);
+        };
 
-                int16_t ret = hardware.writeByte(value);
-                if (ret > 0) {
-                    data.pop();
-                    to_write--;
-                } else if (autoFlush) {
-                    flush();
-                } else {
+        // Called from the interrupt when a write's transfer is done
+        void _writeTransferDone() {
+            if (_write_continue && _write_continue()) {
+                return; // another span is on the way
+            }
+            _writing = false;
+            if (_write_done_callback) {
+                // move it out first, so done can start another write
+                std::function<void(void)> done = std::move(_write_done_callback);
+                _write_done_callback = nullptr;
+                done();
+            }
+        };
+
+
+        // *** XON/XOFF (software) flow control
+        // With UARTMode::XonXoffFlowControl, an XOFF from the other side pauses the TX DMA (the
+        // same way CTS does) and an XON resumes it.
+        //
+        // Sending them: an owner that knows how full it is (BufferedUART's RXBuffer, with its high
+        // and low water marks) calls setRXFlowStopped(). Without one, we send XOFF when a receive
+        // transfer ends and nothing takes its place, and XON once one starts again.
+        //
+        // Receiving them: XON and XOFF are acted on, and are also left in the received data, on
+        // both paths -- the DMA can't leave them out of what it writes, so the bytes caught
+        // between transfers keep them too. A reader that doesn't want them should skip them.
+        // The DMA'd data is scanned for them as transfers end, whenever getRXTransferPosition()
+        // is called, and when the line goes idle (the receiver timeout is kept armed for that,
+        // at kXonXoffScanBitTimes unless setRXIdleCallback() asked for another). So an XOFF is
+        // seen within a couple of characters of a pause. For a steady stream, owners should
+        // keep transfers to kXonXoffScanLength (BufferedUART does), so one is seen within that
+        // many characters -- and on the plain UARTs, which have no receiver timeout, that's all.
+
+        static constexpr uint32_t kXonXoffScanBitTimes = 20; // two characters of idle
+        static constexpr uint16_t kXonXoffScanLength = 32;
+
+        bool _xonXoffFlowControl = false;
+        bool _rx_flow_by_owner = false;                 // setRXFlowStopped() has been used
+        volatile char _xonXoffStartStop = kUARTXOn;     // what we last asked the other side for
+        volatile char _xonXoffToSend = 0;               // XON or XOFF waiting for TX-ready
+
+        // TX can be held back for more than one reason at once, and only resumes when none remain
+        static constexpr uint8_t kTXPausedByCTS = 1 << 0;
+        static constexpr uint8_t kTXPausedByXOff = 1 << 1;
+        static constexpr uint8_t kTXPausedForXOnXOff = 1 << 2;  // so our XON/XOFF goes next
+        volatile uint8_t _tx_paused_by = 0;
+
+        bool isXonXoff() { return _xonXoffFlowControl; };
+
+        // For an owner that tracks its own fill: ask the other side to stop (true), or to carry on.
+        // From then on, transfers starting and ending no longer send XON or XOFF themselves.
+        void setRXFlowStopped(const bool stop) {
+            hardware._setInterruptMasked(true);
+            _rx_flow_by_owner = true;
+            _sendXonXoff(stop ? kUARTXOff : kUARTXOn);
+            hardware._setInterruptMasked(false);
+        };
+
+        // The part of the DMA'd receive data not yet scanned for XON/XOFF, and the queued "next"
+        char *_xonXoffScanPosition = nullptr;
+        char *_xonXoffScanEnd = nullptr;
+        char *_xonXoffNextStart = nullptr;
+        char *_xonXoffNextEnd = nullptr;
+
+        void _pauseTX(uint8_t reason) {
+            _tx_paused_by |= reason;
+            hardware.pauseTX();
+        };
+
+        void _resumeTX(uint8_t reason) {
+            _tx_paused_by &= ~reason;
+            if (!_tx_paused_by) {
+                hardware.resumeTX();
+            }
+        };
+
+        // Returns true if value was XON or XOFF (and acted on)
+        bool _checkXonXoff(const char value) {
+            if (value == kUARTXOff) {
+                _pauseTX(kTXPausedByXOff);
+                return true;
+            }
+            if (value == kUARTXOn) {
+                _resumeTX(kTXPausedByXOff);
+                return true;
+            }
+            return false;
+        };
+
+        void _sendXonXoff(const char value) {
+            if (!_xonXoffFlowControl || _xonXoffStartStop == value) {
+                return;
+            }
+            _xonXoffStartStop = value;
+            _xonXoffToSend = value;
+
+            // Hold the TX DMA, then send it from the TX-ready interrupt
+            _pauseTX(kTXPausedForXOnXOff);
+            hardware._setInterruptTxReady(true);
+        };
+
+        // Scan what the DMA has written up to position. A position outside of the current transfer
+        // means it's done (pass nullptr to finish both transfers).
+        void _scanForXonXoff(char *position) {
+            while (_xonXoffScanPosition != nullptr) {
+                bool moved_on = (position < _xonXoffScanPosition) || (position > _xonXoffScanEnd);
+                char *stop = moved_on ? _xonXoffScanEnd : position;
+                while (_xonXoffScanPosition < stop) {
+                    _checkXonXoff(*_xonXoffScanPosition++);
+                }
+                if (!moved_on) {
                     break;
                 }
-            } while (to_write != 0);
+                _xonXoffScanPosition = _xonXoffNextStart;
+                _xonXoffScanEnd = _xonXoffNextEnd;
+                _xonXoffNextStart = nullptr;
+                _xonXoffNextEnd = nullptr;
+            }
+        };
 
-            if (autoFlush && total_written > 0)
-                flush();
 
-            return total_written;
+        // *** Asynchronous reads
+        // read(buffer, length, done, ...) starts a DMA read and returns right away. The read ends when:
+        //  * length bytes have arrived, or
+        //  * terminator (if >= 0) has arrived, or
+        //  * the line has been idle for idle_bit_times after at least one byte (if non-zero).
+        // done(length_read) is called from the interrupt, or use isReading() and readLength() to poll.
+        // A terminator ends the read, but it may not be the last byte: everything received is kept.
+        //
+        // A terminator is looked for when the line goes idle (or on polling), so it's noticed within a
+        // couple of characters' time of the end of a burst, not the instant it arrives. The idle checks
+        // need the USART receiver timeout: on the plain UARTs, idle_bit_times isn't available (the
+        // read isn't started), and a terminator is only seen on polling or when the read fills.
+        // Only one read at a time, and not while an RXBuffer is using the port.
+
+        static constexpr uint32_t kReadTerminatorCheckBitTimes = 20; // two characters of idle
+
+        volatile bool _reading = false;
+        char *_read_buffer = nullptr;
+        uint16_t _read_length = 0;
+        uint16_t _read_scanned = 0;
+        int16_t _read_terminator = -1;
+        bool _read_ends_on_idle = false;
+        volatile uint16_t _read_done_length = 0;
+        std::function<void(uint16_t)> _read_done_callback;
+
+        bool read(char *buffer, const uint16_t length, std::function<void(uint16_t)> &&done, const int16_t terminator = -1, const uint32_t idle_bit_times = 0) {
+            if (_reading || (length == 0) || hardware.isRXTransferActive()) {
+                return false;
+            }
+
+            if (idle_bit_times || (terminator >= 0)) {
+                if (!hardware.setRxIdleTimeout(idle_bit_times ? idle_bit_times : kReadTerminatorCheckBitTimes)) {
+                    if (idle_bit_times) {
+                        return false;
+                    }
+                }
+            }
+
+            _read_buffer = buffer;
+            _read_length = length;
+            _read_scanned = 0;
+            _read_terminator = terminator;
+            _read_ends_on_idle = (idle_bit_times != 0);
+            _read_done_length = 0;
+            _read_done_callback = std::move(done);
+
+            hardware._setInterruptMasked(true);
+            _reading = true;
+            // This may fill some (or all) of the buffer right away from the overflow buffer
+            char *start = buffer;
+            startRXTransfer(start, length);
+            _checkRead(/*transfer_over =*/ false, /*idle =*/ false);
+            hardware._setInterruptMasked(false);
+            return true;
+        };
+
+        // Poll instead of (or as well as) using the callback
+        bool isReading() {
+            if (_reading) {
+                hardware._setInterruptMasked(true);
+                if (_reading) {
+                    _checkRead(false, false);
+                }
+                hardware._setInterruptMasked(false);
+            }
+            return _reading;
+        };
+
+        // How much has been read so far, or the final length once it's done
+        uint16_t readLength() {
+            if (isReading()) {
+                return _readPosition() - _read_buffer;
+            }
+            return _read_done_length;
+        };
+
+        // End the read now (done is still called, with what has arrived)
+        void cancelRead() {
+            hardware._setInterruptMasked(true);
+            if (_reading) {
+                _finishRead();
+            }
+            hardware._setInterruptMasked(false);
+        };
+
+        char *_readPosition() {
+            char *position = _manual_rx_position ? _manual_rx_position : hardware.getRXTransferPosition();
+            if ((position < _read_buffer) || (position > _read_buffer + _read_length)) {
+                return _read_buffer; // not ours (yet)
+            }
+            return position;
+        };
+
+        // Called with our interrupt held off (or from it)
+        void _checkRead(const bool transfer_over, const bool idle) {
+            uint16_t read_so_far = _readPosition() - _read_buffer;
+
+            if (_read_terminator >= 0) {
+                while (_read_scanned < read_so_far) {
+                    if (_read_buffer[_read_scanned++] == (char)_read_terminator) {
+                        _finishRead();
+                        return;
+                    }
+                }
+            }
+
+            if (transfer_over || (read_so_far == _read_length) || (idle && _read_ends_on_idle && (read_so_far > 0))) {
+                _finishRead();
+            }
+        };
+
+        void _finishRead() {
+            // Stop the DMA where it is, and go back to catching bytes in the overflow buffer
+            hardware.setInterruptRxTransferDone(false);
+            hardware.flushRead();
+            _setSoftwareRTS(true); // active low
+            _setInterruptRxReady(true);
+            hardware.setRxIdleTimeout(_rxIdleTimeout());
+
+            _read_done_length = _readPosition() - _read_buffer;
+            _reading = false;
+            if (_read_done_callback) {
+                // move it out first, so done can start another read
+                std::function<void(uint16_t)> done = std::move(_read_done_callback);
+                _read_done_callback = nullptr;
+                done(_read_done_length);
+            }
+        };
+
+
+        // *** Multidrop (9-bit) addressing
+        // With UARTMode::Multidrop, every byte has a 9th bit that is set only on address bytes, and a
+        // frame is an address byte followed by data. The USART flags address bytes (and can't filter
+        // them itself), so that's the only interrupt we take: frames for other nodes are ignored
+        // without an interrupt per byte, and frames for us are received by DMA.
+        //
+        // readFrame() arms the next frame to our address (or the broadcast address) to be read into
+        // buffer. The frame ends when the next address byte arrives, buffer fills, or (if non-zero)
+        // the line has been idle for idle_bit_times. done(address, length) is then called from the
+        // interrupt; call readFrame() again (from done is fine) for the next one. Frames that come
+        // while not armed are counted in framesMissed().
+        //
+        // When the next address byte ends a frame, the DMA has already taken that byte too, so it's
+        // dropped from the end of the length. (This assumes the interrupt runs within a character time.)
+        //
+        // writeFrame() sends an address byte (SENDA) and then the data by DMA. It can't be mixed with
+        // a TXBuffer, which could have bytes in flight when the address goes out.
+
+        bool _multidrop = false;
+        uint8_t _multidrop_address = 0;
+        uint8_t _multidrop_broadcast_address = 0xFF;
+
+        char *_frame_buffer = nullptr;
+        uint16_t _frame_length = 0;
+        uint32_t _frame_idle_bit_times = 0;
+        uint8_t _frame_address = 0;
+        bool _frame_ended_by_address = false;
+        uint32_t _frames_missed = 0;
+        std::function<void(uint8_t, uint16_t)> _frame_done_callback;
+
+        void setMultidropAddress(const uint8_t address, const uint8_t broadcast_address = 0xFF) {
+            _multidrop_address = address;
+            _multidrop_broadcast_address = broadcast_address;
+        };
+
+        bool readFrame(char *buffer, const uint16_t length, std::function<void(uint8_t, uint16_t)> &&done, const uint32_t idle_bit_times = 0) {
+            if (!_multidrop || (length == 0)) {
+                return false;
+            }
+            hardware._setInterruptMasked(true);
+            _frame_buffer = buffer;
+            _frame_length = length;
+            _frame_idle_bit_times = idle_bit_times;
+            _frame_done_callback = std::move(done);
+            hardware._setInterruptMasked(false);
+            return true;
+        };
+
+        uint32_t framesMissed() { return _frames_missed; };
+
+        // Called from the interrupt with the address byte that just arrived
+        void _handleAddress(const uint8_t address) {
+            if (_reading) {
+                // That's the end of the frame we were in
+                _frame_ended_by_address = true;
+                cancelRead();
+                _frame_ended_by_address = false;
+            }
+
+            if ((address != _multidrop_address) && (address != _multidrop_broadcast_address)) {
+                return; // not for us
+            }
+            if (!_frame_done_callback) {
+                _frames_missed++;
+                return;
+            }
+
+            _frame_address = address;
+            hardware._setInterruptRxOverrun(true); // we're reading now, so overruns are real
+            read(_frame_buffer, _frame_length, [&](uint16_t read_length) { // use a closure
+                this->_frameDone(read_length);
+            }, /*terminator =*/ -1, _frame_idle_bit_times);
+        };
+
+        void _frameDone(uint16_t length) {
+            hardware._setInterruptRxOverrun(false);
+            if (_frame_ended_by_address && (length > 0)) {
+                length--; // that was the next address byte
+            }
+            if (_frame_done_callback) {
+                // move it out first, so done can call readFrame()
+                std::function<void(uint8_t, uint16_t)> done = std::move(_frame_done_callback);
+                _frame_done_callback = nullptr;
+                done(_frame_address, length);
+            }
+        };
+
+        // Sends address (with the 9th bit set), then data (by DMA, like write(): blocking, or
+        // asynchronous if given done). Returns the data length, or 0 if busy.
+        int16_t writeFrame(const uint8_t address, const char* data, const uint16_t length, std::function<void(void)> &&done = nullptr) {
+            if (!_multidrop || _writing || (length == 0) || !hardware.writeAddress(address)) {
+                return 0;
+            }
+            if (done) {
+                return write(data, length, std::move(done));
+            }
+            return write(data, length);
         };
 
 
@@ -307,9 +837,32 @@ namespace Motate {
         }
 
         char* _manual_rx_position = nullptr;
-        bool startRXTransfer(char *&buffer, uint16_t length) {
+        bool startRXTransfer(char *&buffer, uint16_t length, bool include_next = false) {
             hardware.setInterruptRxReady(false);
 
+            if (include_next && hardware.isRXTransferActive()) {
+                // Queue it behind the running transfer, if the hardware can. The overflow buffer
+                // only fills between transfers, so there's nothing to drain here.
+                if (_xonXoffFlowControl) {
+                    hardware._setInterruptMasked(true);
+                }
+                if (hardware.startRXTransfer(buffer, length, true)) {
+                    // If the running transfer ended before we got here, this one took its place
+                    // and the interrupt may have turned RX-ready back on.
+                    hardware.setInterruptRxReady(false);
+                    if (_xonXoffFlowControl) {
+                        _xonXoffNextStart = buffer;
+                        _xonXoffNextEnd = buffer + length;
+                        hardware._setInterruptMasked(false);
+                    }
+                    return true;
+                }
+                if (_xonXoffFlowControl) {
+                    hardware._setInterruptMasked(false);
+                }
+                return false;
+            }
+
             int16_t overflow;
             while (((overflow = overflowBuffer.read()) > 0) && (length > 0)) {
                 *buffer = (char)overflow;
@@ -322,19 +875,31 @@ namespace Motate {
 
             } else {
                 _manual_rx_position = nullptr;
+                if (_xonXoffFlowControl) {
+                    // Anything left to scan is from transfers that are over
+                    hardware._setInterruptMasked(true);
+                    _scanForXonXoff(nullptr);
+                }
                 if (hardware.startRXTransfer(buffer, length)) {
-                    if (!isRealAndCorrectRTSPin<rtsPinNumber, rxPinNumber>()) {
-                        rtsPin = false; // active low
+                    _setSoftwareRTS(false); // active low
+                    if (_xonXoffFlowControl) {
+                        _xonXoffScanPosition = buffer;
+                        _xonXoffScanEnd = buffer + length;
+                        hardware._setInterruptMasked(false);
+                        if (!_rx_flow_by_owner) {
+                            _sendXonXoff(kUARTXOn);
+                        }
                     }
                     return true;
                 }
+                if (_xonXoffFlowControl) {
+                    hardware._setInterruptMasked(false);
+                }
             }
 
-            if (!isRealAndCorrectRTSPin<rtsPinNumber, rxPinNumber>()) {
-                rtsPin = true; // active low
-            }
+            _setSoftwareRTS(true); // active low
 
-            hardware.setInterruptRxReady(true);
+            _setInterruptRxReady(true);
             return false;
         };
 
@@ -342,13 +907,52 @@ namespace Motate {
             if (_manual_rx_position) {
                 return _manual_rx_position;
             }
-            return hardware.getRXTransferPosition();
+            char *position = hardware.getRXTransferPosition();
+            if (_xonXoffFlowControl) {
+                hardware._setInterruptMasked(true);
+                _scanForXonXoff(position);
+                hardware._setInterruptMasked(false);
+            }
+            return position;
         };
 
         void setRXTransferDoneCallback(std::function<void()> &&callback) {
             transfer_rx_done_callback = std::move(callback);
         }
 
+        // Circular receive: the DMA fills buffer over and over on its own, with no per-transfer
+        // or per-byte interrupts, and getRXTransferPosition() says where it's writing. This
+        // replaces startRXTransfer() until stopRXRing(). Returns false without the hardware for
+        // it (only the XDMAC can). Anything that came in before the ring started is put at the
+        // beginning of it. XON/XOFF isn't looked for in the ring.
+        bool startRXRing(char *buffer, const uint32_t length) {
+            if (!hardware.canRXRing() || (length == 0)) {
+                return false;
+            }
+            hardware.setInterruptRxReady(false);
+            hardware.setInterruptRxTransferDone(false);
+
+            uint32_t start_offset = 0;
+            int16_t overflow;
+            while ((start_offset < length - 1) && ((overflow = overflowBuffer.read()) >= 0)) {
+                buffer[start_offset++] = (char)overflow;
+            }
+
+            _manual_rx_position = nullptr;
+            if (!hardware.startRXRing(buffer, length, start_offset)) {
+                _setInterruptRxReady(true);
+                return false;
+            }
+            _setSoftwareRTS(false); // active low
+            return true;
+        };
+
+        void stopRXRing() {
+            hardware.stopRXRing();
+            _setSoftwareRTS(true); // active low
+            _setInterruptRxReady(true);
+        };
+
 
         bool startTXTransfer(char *buffer, const uint16_t length) {
             return hardware.startTXTransfer(buffer, length);
@@ -365,42 +969,153 @@ namespace Motate {
             transfer_tx_done_callback = std::move(callback);
         }
 
+        // *** Line errors
+        // Overruns, framing and parity errors are counted, then cleared right away (RSTSTA) so the
+        // receiver carries on. Any DMA transfer keeps going as well: its position is still where the
+        // data really is, so an RXBuffer needs no fixing up -- the bytes are just gone (or wrong).
+        struct ErrorCounts {
+            uint32_t overruns = 0;
+            uint32_t framing_errors = 0;
+            uint32_t parity_errors = 0;
+        };
+        ErrorCounts _error_counts;
+
+        // A copy, since the counts are updated from the interrupt
+        ErrorCounts getErrorCounts() {
+            hardware._setInterruptMasked(true);
+            ErrorCounts counts = _error_counts;
+            hardware._setInterruptMasked(false);
+            return counts;
+        };
+
+        void resetErrorCounts() {
+            hardware._setInterruptMasked(true);
+            _error_counts = ErrorCounts {};
+            hardware._setInterruptMasked(false);
+        };
+
+        // callback is called (from the interrupt) with the UARTInterrupt::OnRx*Error bits seen
+        void setRXErrorCallback(std::function<void(uint16_t)> &&callback) {
+            rx_error_callback = std::move(callback);
+        };
+
+        // Call callback (from the interrupt) once the line has been idle for bit_times after
+        // receiving a character, so a short message that doesn't fill the transfer is seen
+        // without polling. Fires once per burst of data. A bit_times of 0 (or no callback) turns
+        // it off. Returns false if the hardware has no receiver timeout (the plain UARTs).
+        bool setRXIdleCallback(const uint32_t bit_times, std::function<void()> &&callback) {
+            rx_idle_callback = std::move(callback);
+            _rx_idle_bit_times = rx_idle_callback ? bit_times : 0;
+            return hardware.setRxIdleTimeout(_rxIdleTimeout()) || (_rx_idle_bit_times == 0);
+        }
+        uint32_t _rx_idle_bit_times = 0;
+
+        // The receiver timeout to keep armed outside of read(): the idle callback's, or with
+        // XON/XOFF, a short one so an XOFF the DMA received is seen once the line pauses.
+        uint32_t _rxIdleTimeout() {
+            if (_rx_idle_bit_times) {
+                return _rx_idle_bit_times;
+            }
+            return _xonXoffFlowControl ? kXonXoffScanBitTimes : 0;
+        };
+
         // *** Handling interrupts
 
         void uartInterruptHandler(uint16_t interruptCause) {
             if (interruptCause & UARTInterrupt::OnTxReady) {
                 // ready to transfer...
+                if (_xonXoffToSend) {
+                    hardware.writeByte(_xonXoffToSend);
+                    _xonXoffToSend = 0;
+                    hardware._setInterruptTxReady(false);
+                    _resumeTX(kTXPausedForXOnXOff);
+                }
             }
 
             if (interruptCause & UARTInterrupt::OnRxReady) {
                 // new data is ready to read. If we're between transfers we need to squirrel away the value
-                overflowBuffer.write(hardware.readByte());
+                int16_t value = hardware.readByte();
+                if (_xonXoffFlowControl) {
+                    _checkXonXoff(value);
+                }
+                overflowBuffer.write(value);
             }
 
             if (interruptCause & UARTInterrupt::OnTxTransferDone) {
-                if (transfer_tx_done_callback) {
+                if (_writing) {
+                    hardware.setInterruptTxTransferDone(false);
+                    _writeTransferDone();
+                } else if (transfer_tx_done_callback) {
                     hardware.setInterruptTxTransferDone(false);
                     transfer_tx_done_callback();
                 }
             }
 
             if (interruptCause & UARTInterrupt::OnRxTransferDone) {
-                if (!isRealAndCorrectRTSPin<rtsPinNumber, rxPinNumber>()) {
-                    rtsPin = true; // active low
+                if (_xonXoffFlowControl) {
+                    _scanForXonXoff(hardware.getRXTransferPosition());
                 }
                 hardware.setInterruptRxTransferDone(false);
-                hardware.setInterruptRxReady(true);
-                if (transfer_rx_done_callback) {
+                if (hardware.isRXTransferActive()) {
+                    // The DMA moved on to the queued "next" transfer, so watch for the end of that one
+                    hardware.setInterruptRxTransferDone(true);
+                } else {
+                    _setSoftwareRTS(true); // active low
+                    _setInterruptRxReady(true);
+                }
+                if (_reading) {
+                    _checkRead(/*transfer_over =*/ !hardware.isRXTransferActive(), /*idle =*/ false);
+                } else if (transfer_rx_done_callback) {
                     transfer_rx_done_callback();
                 }
+                if (!hardware.isRXTransferActive() && !_rx_flow_by_owner) {
+                    // Nowhere left to put data, so ask the other side to stop
+                    _sendXonXoff(kUARTXOff);
+                }
             }
             
+            if (interruptCause & UARTInterrupt::OnRxError) {
+                hardware._clearRxErrors();
+                if (interruptCause & UARTInterrupt::OnRxOverrun) {
+                    _error_counts.overruns++;
+                }
+                if (interruptCause & UARTInterrupt::OnRxFramingError) {
+                    _error_counts.framing_errors++;
+                }
+                if (interruptCause & UARTInterrupt::OnRxParityError) {
+                    _error_counts.parity_errors++;
+                }
+                if (rx_error_callback) {
+                    rx_error_callback(interruptCause & UARTInterrupt::OnRxError);
+                }
+            }
+
+            if (interruptCause & UARTInterrupt::OnRxAddress) {
+                uint8_t address = hardware._readAddress();
+                hardware._clearRxErrors();
+                _handleAddress(address);
+            }
+
+            if (interruptCause & UARTInterrupt::OnRxIdle) {
+                // re-arm for the next burst
+                hardware._restartRxIdleTimeout();
+                if (_xonXoffFlowControl && !_manual_rx_position) {
+                    _scanForXonXoff(hardware.getRXTransferPosition());
+                }
+                if (_reading) {
+                    _checkRead(/*transfer_over =*/ false, /*idle =*/ true);
+                }
+                if (rx_idle_callback) {
+                    rx_idle_callback();
+                }
+            }
+
             if (interruptCause & UARTInterrupt::OnCTSChanged) {
-                if (!isRealAndCorrectCTSPin<ctsPinNumber, rxPinNumber>()) {
+                if (!isRealAndCorrectCTSPin<ctsPinNumber, rxPinNumber>() && !_rs485) {
                     if (isConnected()) {
-                        hardware.resumeTX();
+                        _resumeTX(kTXPausedByCTS);
                     } else {
-                        hardware.pauseTX();
+                        _pauseTX(kTXPausedByCTS);
                     }
                 }
                 if (connection_state_changed_callback && isConnected()) {
@@ -412,5 +1127,214 @@ namespace Motate {
         
     };
 
+
+#if defined(__SAM3X8E__) || defined(__SAM3X8C__) || defined(__SAM4E8E__) || defined(__SAM4E16E__) || defined(__SAM4E8C__) || defined(__SAM4E16C__) || defined(__SAMS70N19__) || defined(__SAMS70N20__) || defined(__SAMS70N21__)
+
+    // A UART with DMA-fed receive and transmit buffers -- the PDC, or the XDMAC on the S70 -- so
+    // reads and writes only touch memory, and never wait on the line unless asked to.
+    // The RXBuffer queues ping-pong transfers where the DMA can, so the receiver isn't left
+    // without somewhere to put data between transfers.
+    //
+    // The UART can't hook up its interrupts from its constructor, so that (and starting the
+    // buffers) is done on first use, or call init() from setup() to do it up front.
+    template<pin_number rxPinNumber, pin_number txPinNumber, pin_number rtsPinNumber = -1, pin_number ctsPinNumber = -1, uint32_t rxBufferSize = 256, uint32_t txBufferSize = rxBufferSize>
+    struct BufferedUART {
+        typedef UART<rxPinNumber, txPinNumber, rtsPinNumber, ctsPinNumber> uart_type;
+        typedef Motate::RXBuffer<rxBufferSize, uart_type*> rx_buffer_type;
+        typedef Motate::TXBuffer<txBufferSize, uart_type*> tx_buffer_type;
+
+        uart_type uart;
+        rx_buffer_type rxBuffer {&uart};
+        tx_buffer_type txBuffer {&uart};
+
+        bool _inited = false;
+
+        BufferedUART(const uint32_t baud = 115200, const uint16_t options = UARTMode::As8N1) : uart{baud, options} {};
+
+        void init() {
+            if (_inited) {
+                return;
+            }
+            _inited = true;
+            uart.init();
+            rxBuffer.init();
+            txBuffer.init();
+            _setupRXFlowControl();
+
+            // The RXBuffer only hands the DMA a transfer when it's read from and finds itself
+            // empty, so do that now rather than losing whatever arrives before the first read.
+            typename rx_buffer_type::index_type length;
+            rxBuffer.readSpan(length);
+        };
+
+        void setOptions(const uint32_t baud, const uint16_t options, const bool fromConstructor=false) {
+            uart.setOptions(baud, options, fromConstructor);
+            if (_inited) {
+                _setupRXFlowControl();
+            }
+        };
+
+        // With XON/XOFF, the RXBuffer asks the other side to stop once it's 3/4 full, and to
+        // carry on once it's under 1/4, and keeps transfers short enough that an XOFF from the
+        // other side is seen promptly (see the UART).
+        void _setupRXFlowControl() {
+            if (uart.isXonXoff()) {
+                rxBuffer.setFlowControl(rxBufferSize - (rxBufferSize / 4), rxBufferSize / 4, [&](bool stop) { // use a closure
+                    uart.setRXFlowStopped(stop);
+                });
+                rxBuffer.setTransferLimit(uart_type::kXonXoffScanLength);
+            } else {
+                rxBuffer.setFlowControl(0, 0, nullptr);
+                rxBuffer.setTransferLimit(0);
+            }
+        };
+
+        uint32_t getBaud() { return uart.getBaud(); };
+
+        bool isConnected() { return uart.isConnected(); };
+
+        void setConnectionCallback(std::function<void(bool)> &&callback) {
+            init();
+            uart.setConnectionCallback(std::move(callback));
+        };
+
+        // The UART already hooks the CTS pin's interrupt itself, so nothing has to call this. It's
+        // here so a MOTATE_PIN_INTERRUPT(ctsPinNumber) written for the KL05Z or XMega BufferedUART
+        // still has something to call.
+        void pinChangeInterrupt() {
+            uart.uartInterruptHandler(UARTInterrupt::OnCTSChanged);
+        };
+
+        // *** Reading -- none of these block
+
+        // Returns -1 if there's nothing to read
+        int16_t readByte() {
+            init();
+            return rxBuffer.read();
+        };
+
+        // Copies out up to length values that have already arrived, and returns how many.
+        uint16_t read(char *buffer, const uint16_t length) {
+            init();
+            uint16_t total_read = 0;
+            while (total_read < length) {
+                typename rx_buffer_type::index_type span_length;
+                const char *span = rxBuffer.readSpan(span_length);
+                if (span_length == 0) {
+                    break;
+                }
+                if (span_length > (length - total_read)) {
+                    span_length = length - total_read;
+                }
+                memcpy(buffer + total_read, span, span_length);
+                rxBuffer.consume(span_length);
+                total_read += span_length;
+            }
+            return total_read;
+        };
+
+        // Read in place: the largest contiguous run that's arrived, then consume() what was used
+        char *readSpan(typename rx_buffer_type::index_type &length) {
+            init();
+            return rxBuffer.readSpan(length);
+        };
+
+        void consume(const typename rx_buffer_type::index_type length) {
+            rxBuffer.consume(length);
+        };
+
+        // How many values are waiting to be read (the buffers' own available() is free space)
+        typename rx_buffer_type::size_type available() {
+            init();
+            return rxBuffer.size() - rxBuffer.available();
+        };
+
+        void flushRead() {
+            rxBuffer.flush();
+        };
+
+        // *** Writing -- these only block with autoFlush
+
+        // Returns -1 if there's no room
+        int16_t writeByte(const uint8_t data) {
+            init();
+            return txBuffer.write_nb((const char *)&data, 1) ? 1 : -1;
+        };
+
+        // Queues as much as fits and returns how much that was, or with autoFlush, waits for room
+        // for all of it and then for it to be sent. A length of 0 means data is a null-terminated string.
+        size_t write(const char* data, const size_t length = 0, bool autoFlush = false) {
+            init();
+            size_t to_write = length ? length : strlen(data);
+            if (to_write == 0) {
+                return 0;
+            }
+
+            if (autoFlush) {
+                txBuffer.write(data, to_write);
+                flush();
+                return to_write;
+            }
+
+            return txBuffer.write_nb(data, to_write);
+        };
+
+        // Moves up to length values (0 for all of them) out of data, a span at a time
+        template<uint32_t _size>
+        size_t write(Motate::Buffer<_size> &data, const size_t length = 0, bool autoFlush = false) {
+            init();
+            size_t to_write = length ? length : data.size();
+            size_t total_written = 0;
+            while (to_write > 0) {
+                typename Motate::Buffer<_size>::index_type span_length;
+                const char *span = data.readSpan(span_length);
+                if (span_length > to_write) {
+                    span_length = to_write;
+                }
+                if (span_length == 0) {
+                    break;
+                }
+
+                size_t written = span_length;
+                if (autoFlush) {
+                    txBuffer.write(span, span_length);
+                } else {
+                    written = txBuffer.write_nb(span, span_length);
+                    if (written == 0) {
+                        break;
+                    }
+                }
+                data.consume(written);
+                to_write -= written;
+                total_written += written;
+            }
+
+            if (autoFlush) {
+                flush();
+            }
+            return total_written;
+        };
+
+        // Write in place: the largest contiguous run of free space, then commit() what was filled
+        char *reserve(typename tx_buffer_type::index_type &length) {
+            init();
+            return txBuffer.reserve(length);
+        };
+
+        void commit(const typename tx_buffer_type::index_type length) {
+            txBuffer.commit(length);
+        };
+
+        // Waits for everything queued to go out on the line
+        void flush() {
+            while (!txBuffer.isEmpty()) {
+                ;
+            }
+            uart.flush();
+        };
+    };
+
+#endif // SAM3X, SAM4E, SAMS70 (KL05Z and XMega have their own BufferedUART)
+
 }
 #endif /* end of include guard: MOTATEUART_H_ONCE */
\ No newline at end of file
@@ -296,7 +296,7 @@ namespace Motate {
             return usb.readByte(read_endpoint);
         };
  
-        // BLOCKING!!
+        // BLOCKING!! See the asynchronous read() below.
         uint16_t read(char *buffer, const uint16_t length) {
             int16_t total_read = 0;
             int16_t to_read = length;
@@ -339,7 +339,10 @@ namespace Motate {
         };
 
         USB_DMA_Descriptor _rx_dma_descriptor;
-        bool startRXTransfer(char *buffer, const uint16_t length) {
+        bool startRXTransfer(char *buffer, const uint16_t length, bool include_next = false) {
+            if (include_next) {
+                return false; // one descriptor per endpoint, so we can't queue a "next" transfer
+            }
             _rx_dma_descriptor.setBuffer(buffer, length);
             // DON'T allow the DMA transfer to be stopped if the buffer runs out
             // IOW, don't stop reading when a packet doesn't fill the buffer.
@@ -355,6 +358,114 @@ namespace Motate {
             transfer_rx_done_callback = std::move(callback);
         }
 
+        // *** Asynchronous reads
+        // read(buffer, length, done, terminator) starts a DMA read and returns right away. The read
+        // ends when length bytes have arrived, or when terminator (if >= 0) has. The USB DMA only
+        // ends a transfer early on a short packet, so a full-size one would go by unscanned. With
+        // a terminator the read is made of one-packet transfers instead, each scanned as it ends,
+        // for an interrupt per packet. A packet may carry more after the terminator -- everything
+        // received is kept. There's no idle timeout over USB (the host decides when packets
+        // come), but cancelRead() can end a read at any time.
+        // done(length_read) is called from the interrupt, or use isReading() and readLength() to poll.
+        // Only one read at a time, and not while an RXBuffer is using the endpoint.
+
+        volatile bool _reading = false;
+        char *_read_buffer = nullptr;
+        uint16_t _read_length = 0;
+        uint16_t _read_scanned = 0;
+        int16_t _read_terminator = -1;
+        volatile uint16_t _read_done_length = 0;
+        std::function<void(uint16_t)> _read_done_callback;
+
+        bool read(char *buffer, const uint16_t length, std::function<void(uint16_t)> &&done, const int16_t terminator = -1) {
+            if (_reading || (length == 0)) {
+                return false;
+            }
+
+            _read_buffer = buffer;
+            _read_length = length;
+            _read_scanned = 0;
+            _read_terminator = terminator;
+            _read_done_length = 0;
+            _read_done_callback = std::move(done);
+
+            _reading = true;
+            if (!_startReadTransfer(0)) {
+                _reading = false;
+                _read_done_callback = nullptr;
+                return false;
+            }
+            return true;
+        };
+
+        bool isReading() { return _reading; };
+
+        // How much has been read so far, or the final length once it's done
+        uint16_t readLength() {
+            if (_reading) {
+                return _readPosition() - _read_buffer;
+            }
+            return _read_done_length;
+        };
+
+        // End the read now (done is still called, with what has arrived)
+        void cancelRead() {
+            if (_reading) {
+                flushRead();
+                _finishRead(_readPosition() - _read_buffer);
+            }
+        };
+
+        char *_readPosition() {
+            char *position = getRXTransferPosition();
+            if ((position < _read_buffer) || (position > _read_buffer + _read_length)) {
+                return _read_buffer; // not ours (yet)
+            }
+            return position;
+        };
+
+        // Called from handleTransferDone() when a short packet (or the end of the buffer) ends a
+        // transfer
+        void _readTransferDone() {
+            uint16_t read_so_far = _readPosition() - _read_buffer;
+
+            if (_read_terminator >= 0) {
+                while (_read_scanned < read_so_far) {
+                    if (_read_buffer[_read_scanned++] == (char)_read_terminator) {
+                        _finishRead(read_so_far);
+                        return;
+                    }
+                }
+            }
+
+            if ((read_so_far == _read_length) || !_startReadTransfer(read_so_far)) {
+                _finishRead(read_so_far);
+            }
+        };
+
+        // The rest of the read from offset, or just the next packet of it if there's a terminator
+        bool _startReadTransfer(const uint16_t offset) {
+            uint16_t length = _read_length - offset;
+            if (_read_terminator >= 0) {
+                uint16_t packet_size = usb.getEndpointSize(read_endpoint, /*otherSpeed*/ false);
+                if ((packet_size > 0) && (length > packet_size)) {
+                    length = packet_size;
+                }
+            }
+            return startRXTransfer(_read_buffer + offset, length);
+        };
+
+        void _finishRead(const uint16_t length) {
+            _read_done_length = length;
+            _reading = false;
+            if (_read_done_callback) {
+                // move it out first, so done can start another read
+                std::function<void(uint16_t)> done = std::move(_read_done_callback);
+                _read_done_callback = nullptr;
+                done(length);
+            }
+        };
+
 
         USB_DMA_Descriptor _tx_dma_descriptor;
         bool startTXTransfer(char *buffer, const uint16_t length) {
@@ -467,6 +578,10 @@ namespace Motate {
         // This is to be called from USBDeviceHardware when a transfer is done.
         // It returns if the request was handled or not.
         bool handleTransferDone(const uint8_t &endpointNum) {
+            if (_reading && (endpointNum == read_endpoint)) {
+                _readTransferDone();
+                return true;
+            }
             if (transfer_rx_done_callback && (endpointNum == read_endpoint)) {
                 transfer_rx_done_callback();
                 return true;
@@ -0,0 +1,100 @@
+/*
+ buffer_span_bench.cpp - Compare the span API of Buffer against the per-byte read()/write()
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Moves the same bytes through a Buffer<1024> in 256-byte bursts, once a byte at a time with
+// write()/read(), and once with reserve()/commit() and readSpan()/consume() (and memcpy).
+
+static constexpr uint32_t kTotalBytes = 64UL * 1024 * 1024;
+static constexpr uint32_t kBurst = 256;
+
+static Buffer<1024> buffer;
+static char source[kBurst];
+static char dest[kBurst];
+
+uint64_t runPerByte() {
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t moved = 0; moved < kTotalBytes; moved += kBurst) {
+        for (uint32_t i = 0; i < kBurst; i++) {
+            buffer.write(source[i]);
+        }
+        for (uint32_t i = 0; i < kBurst; i++) {
+            dest[i] = buffer.read();
+        }
+        MotateTest::keep(dest);
+    }
+    return MotateTest::ticks() - start;
+}
+
+uint64_t runSpans() {
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t moved = 0; moved < kTotalBytes; moved += kBurst) {
+        Buffer<1024>::index_type length;
+        uint32_t done = 0;
+        while (done < kBurst) {
+            char *span = buffer.reserve(length);
+            if (length > kBurst - done) {
+                length = kBurst - done;
+            }
+            memcpy(span, source + done, length);
+            buffer.commit(length);
+            done += length;
+        }
+        done = 0;
+        while (done < kBurst) {
+            char *span = buffer.readSpan(length);
+            if (length > kBurst - done) {
+                length = kBurst - done;
+            }
+            memcpy(dest + done, span, length);
+            buffer.consume(length);
+            done += length;
+        }
+        MotateTest::keep(dest);
+    }
+    return MotateTest::ticks() - start;
+}
+
+int main() {
+    for (uint32_t i = 0; i < kBurst; i++) {
+        source[i] = i & 0x7F;
+    }
+
+    uint64_t per_byte = runPerByte();
+    uint64_t spans = runSpans();
+
+    printf("  per-byte: %8.3f bytes/%s\n", (double)kTotalBytes / per_byte, MotateTest::ticksName());
+    printf("  spans:    %8.3f bytes/%s (%.1fx)\n", (double)kTotalBytes / spans, MotateTest::ticksName(), (double)per_byte / spans);
+
+    return memcmp(source, dest, kBurst) ? 1 : 0;
+}
@@ -0,0 +1,329 @@
+/*
+ buffer_span_test.cpp - Round-trip the span API of Buffer, RXBuffer and TXBuffer
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Stands in for a DMA-capable peripheral (the owner_type of RXBuffer and TXBuffer). The test
+// decides when "the DMA" moves bytes, with putRX() and drainTX(), and gets the transfer-done
+// callback called just like the interrupt would.
+struct SpanOwner {
+    char *rx_pos = nullptr;
+    uint32_t rx_left = 0;
+    std::function<void()> rx_done;
+
+    char *tx_pos = nullptr;
+    uint32_t tx_left = 0;
+    std::function<void()> tx_done;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { rx_done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length, bool include_next = false) {
+        if (include_next) {
+            return false; // no "next" registers here, see rxbuffer_pdc_test for those
+        }
+        rx_pos = buffer;
+        rx_left = length;
+        return true;
+    };
+    char *getRXTransferPosition() { return rx_pos; };
+
+    bool putRX(const char value) {
+        if (rx_left == 0) {
+            return false;
+        }
+        *rx_pos++ = value;
+        if (--rx_left == 0) {
+            rx_done();
+        }
+        return true;
+    };
+
+    void setTXTransferDoneCallback(std::function<void()> &&callback) { tx_done = std::move(callback); };
+    bool startTXTransfer(char *buffer, const uint16_t length) {
+        tx_pos = buffer;
+        tx_left = length;
+        return true;
+    };
+    char *getTXTransferPosition() { return tx_pos; };
+
+    // Send up to count bytes, checking each against expected (which counts up)
+    void drainTX(uint32_t count, uint8_t &expected) {
+        while (count-- && tx_left) {
+            MOTATE_CHECK((uint8_t)*tx_pos == expected);
+            expected++;
+            tx_pos++;
+            if (--tx_left == 0) {
+                tx_done();
+            }
+        }
+    };
+};
+
+// A small, repeatable pseudo-random sequence, so failures can be reproduced
+struct TestRandom {
+    uint32_t seed = 1;
+    uint32_t next(const uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+};
+
+static Buffer<64> buffer;
+static SpanOwner owner;
+static RXBuffer<64, SpanOwner*> rx_buffer {&owner};
+static TXBuffer<64, SpanOwner*> tx_buffer {&owner};
+
+void testBufferEdges() {
+    Buffer<64>::index_type length;
+
+    buffer.readSpan(length);
+    MOTATE_CHECK(length == 0);
+
+    // Empty at offset zero: one slot is always kept open, so full doesn't look like empty
+    char *span = buffer.reserve(length);
+    MOTATE_CHECK(span == buffer._data);
+    MOTATE_CHECK(length == 63);
+    buffer.commit(length);
+    MOTATE_CHECK(buffer.isFull());
+    buffer.reserve(length);
+    MOTATE_CHECK(length == 0);
+
+    // Read all but the last few, then the writable span wraps back to the beginning
+    buffer.readSpan(length);
+    MOTATE_CHECK(length == 63);
+    buffer.consume(60);
+    span = buffer.reserve(length);
+    MOTATE_CHECK(span == buffer._data + 63);
+    MOTATE_CHECK(length == 1);
+    buffer.commit(1);
+    span = buffer.reserve(length);
+    MOTATE_CHECK(span == buffer._data);
+    MOTATE_CHECK(length == 59);
+
+    // ... and the readable span stops at the end of _data
+    span = buffer.readSpan(length);
+    MOTATE_CHECK(span == buffer._data + 60);
+    MOTATE_CHECK(length == 4);
+    buffer.consume(4);
+    MOTATE_CHECK(buffer.isEmpty());
+}
+
+// available() is the free space (counting the slot that's always kept open), wrapped or not
+void testAvailable() {
+    Buffer<64> wrapping;
+    Buffer<64>::index_type length;
+    for (uint32_t step = 0; step < 200; step++) {
+        uint32_t waiting = step % 50;
+        for (uint32_t i = 0; i < waiting; i++) {
+            wrapping.write('x');
+        }
+        MOTATE_CHECK(wrapping.available() == (int32_t)(64 - waiting));
+        while (wrapping.read() >= 0) {
+            ;
+        }
+        wrapping.write('x'); // move the offsets along, so sometimes the data wraps
+        wrapping.read();
+    }
+
+    SpanOwner wrap_owner;
+    RXBuffer<64, SpanOwner*> rx {&wrap_owner};
+    TXBuffer<64, SpanOwner*> tx {&wrap_owner};
+    rx.init();
+    tx.init();
+    rx.readSpan(length);
+    tx._write_offset = 0;
+    uint8_t sent = 0;
+    for (uint32_t step = 0; step < 200; step++) {
+        uint32_t waiting = step % 50;
+
+        for (uint32_t i = 0; i < waiting; i++) {
+            wrap_owner.putRX('x');
+        }
+        MOTATE_CHECK(rx.available() == (int32_t)(64 - waiting));
+        rx.readSpan(length);
+        while (length) {
+            rx.consume(length);
+            rx.readSpan(length);
+        }
+        wrap_owner.putRX('x');
+        rx.read();
+
+        char *span = tx.reserve(length);
+        for (uint32_t i = 0; (i < waiting) && (i < length); i++) {
+            span[i] = sent + i;
+        }
+        tx.commit((waiting < length) ? waiting : length);
+        MOTATE_CHECK(tx.available() == (int32_t)(64 - ((waiting < length) ? waiting : length)));
+        wrap_owner.drainTX(0xFFFF, sent);
+    }
+}
+
+void testBufferRoundTrip() {
+    TestRandom random;
+    // read() returns a (sign extended) char as int16_t, with -1 for empty, so keep to 7 bits
+    uint8_t written = 0, read = 0;
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < 100000; i++) {
+        Buffer<64>::index_type length;
+
+        // Mix the span calls with the per-byte ones, since they share the offsets
+        if (random.next(4) == 0) {
+            if (buffer.write(written) == 1) {
+                written = (written + 1) & 0x7F;
+            }
+        } else {
+            char *span = buffer.reserve(length);
+            if (length) {
+                length = 1 + random.next(length);
+                for (uint32_t j = 0; j < length; j++) {
+                    span[j] = written;
+                    written = (written + 1) & 0x7F;
+                }
+                buffer.commit(length);
+            }
+        }
+
+        if (random.next(4) == 0) {
+            int16_t value = buffer.read();
+            if (value >= 0) {
+                MOTATE_CHECK((uint8_t)value == read);
+                read = (read + 1) & 0x7F;
+                total++;
+            }
+        } else {
+            char *span = buffer.readSpan(length);
+            if (length) {
+                length = 1 + random.next(length);
+                for (uint32_t j = 0; j < length; j++) {
+                    MOTATE_CHECK((uint8_t)span[j] == read);
+                    read = (read + 1) & 0x7F;
+                }
+                buffer.consume(length);
+                total += length;
+            }
+        }
+    }
+    MOTATE_CHECK(total > 100000);
+}
+
+void testRXBufferSpans() {
+    TestRandom random;
+    uint8_t sent = 0, read = 0;
+    uint32_t total = 0;
+
+    rx_buffer.init();
+    RXBuffer<64, SpanOwner*>::index_type length;
+    rx_buffer.readSpan(length); // starts the first transfer
+    MOTATE_CHECK(length == 0);
+
+    for (uint32_t i = 0; i < 100000; i++) {
+        for (uint32_t burst = random.next(40); burst; burst--) {
+            if (owner.putRX(sent)) {
+                sent++;
+            }
+        }
+
+        char *span = rx_buffer.readSpan(length);
+        if (length) {
+            length = 1 + random.next(length);
+            for (uint32_t j = 0; j < length; j++) {
+                MOTATE_CHECK((uint8_t)span[j] == read);
+                read++;
+            }
+            rx_buffer.consume(length);
+            total += length;
+        }
+    }
+    MOTATE_CHECK(total > 100000);
+}
+
+void testTXBufferSpans() {
+    TestRandom random;
+    uint8_t written = 0, sent = 0;
+    uint32_t total = 0;
+
+    tx_buffer.init();
+    for (uint32_t i = 0; i < 100000; i++) {
+        TXBuffer<64, SpanOwner*>::index_type length;
+        char *span = tx_buffer.reserve(length);
+        if (length) {
+            length = 1 + random.next(length);
+            for (uint32_t j = 0; j < length; j++) {
+                span[j] = written++;
+            }
+            tx_buffer.commit(length);
+            total += length;
+        }
+
+        owner.drainTX(random.next(40), sent);
+    }
+    owner.drainTX(0xFFFF, sent);
+    MOTATE_CHECK(sent == written);
+    MOTATE_CHECK(tx_buffer.isEmpty());
+    MOTATE_CHECK(total > 100000);
+}
+
+// write() and write_nb() take a size_t, and return one: more than 32KiB isn't a negative count
+void testTXBufferLargeWrite() {
+    static SpanOwner large_owner;
+    static TXBuffer<65536, SpanOwner*> large {&large_owner};
+    static char source[40960]; // a multiple of 256, so the pattern carries on from one write to the next
+    for (uint32_t i = 0; i < sizeof(source); i++) {
+        source[i] = (char)i;
+    }
+    large.init();
+    large._write_offset = 0;
+
+    uint8_t sent = 0;
+    MOTATE_CHECK(large.write_nb(source, sizeof(source)) == sizeof(source));
+    large.flush(); // write_nb() only starts the DMA itself when it fills up
+    large_owner.drainTX(0xFFFFFFFF, sent);
+    MOTATE_CHECK(large.write(source, sizeof(source)) == sizeof(source));
+    large_owner.drainTX(0xFFFFFFFF, sent);
+    MOTATE_CHECK(sent == (uint8_t)(2 * sizeof(source)));
+    MOTATE_CHECK(large.isEmpty());
+
+    // and a full one takes none
+    MOTATE_CHECK(large.write_nb(source, sizeof(source)) == sizeof(source));
+    MOTATE_CHECK(large.write_nb(source, sizeof(source)) == 65535 - sizeof(source));
+    MOTATE_CHECK(large.write_nb(source, 1) == 0);
+}
+
+int main() {
+    testBufferEdges();
+    testAvailable();
+    testBufferRoundTrip();
+    testRXBufferSpans();
+    testTXBufferSpans();
+    testTXBufferLargeWrite();
+    return MotateTest::testResult();
+}
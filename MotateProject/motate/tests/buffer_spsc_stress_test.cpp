@@ -0,0 +1,131 @@
+/*
+ buffer_spsc_stress_test.cpp - Run a Buffer producer and consumer on two threads at full speed
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+#include <thread>
+
+using namespace Motate;
+
+// The producer and the consumer each run flat out on their own thread (so, on a multi-core
+// host, on their own core), mixing the per-byte and span calls. If the acquire/release
+// ordering on _read_offset and _write_offset were wrong, the consumer would sooner or later
+// see an index before the data it guards, and read a stale byte.
+//
+// read() returns a (sign extended) char as int16_t, with -1 for empty, so the pattern is a
+// 7-bit count. A side that finds nothing to do yields, which costs nothing when the threads
+// really are on two cores, and keeps the test from crawling when they aren't.
+
+static constexpr uint32_t kTotalBytes = 20UL * 1000 * 1000;
+
+template <typename buffer_t>
+void stress(buffer_t &buffer) {
+    typedef typename buffer_t::index_type index_t;
+
+    std::thread producer([&buffer] {
+        uint8_t value = 0;
+        for (uint32_t i = 0; i < kTotalBytes; ) {
+            if (i & 1) {
+                if (buffer.write(value) == 1) {
+                    value = (value + 1) & 0x7F;
+                    i++;
+                } else {
+                    std::this_thread::yield();
+                }
+            } else {
+                index_t length;
+                char *span = buffer.reserve(length);
+                if (length > (i & 0x1F) + 1) {
+                    length = (i & 0x1F) + 1;
+                }
+                if (length > kTotalBytes - i) {
+                    length = kTotalBytes - i;
+                }
+                for (index_t j = 0; j < length; j++) {
+                    span[j] = value;
+                    value = (value + 1) & 0x7F;
+                }
+                buffer.commit(length);
+                i += length;
+                if (length == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+
+    uint8_t expected = 0;
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < kTotalBytes; ) {
+        if (i % 3) {
+            int16_t value = buffer.read();
+            if (value >= 0) {
+                if (value != expected) {
+                    errors++;
+                }
+                expected = (value + 1) & 0x7F;
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        } else {
+            index_t length;
+            char *span = buffer.readSpan(length);
+            for (index_t j = 0; j < length; j++) {
+                if (span[j] != expected) {
+                    errors++;
+                }
+                expected = (span[j] + 1) & 0x7F;
+            }
+            buffer.consume(length);
+            i += length;
+            if (length == 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    producer.join();
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(buffer.isEmpty());
+}
+
+// Small enough that the two sides are always bumping into each other, and big enough (with
+// 16-bit offsets) that they mostly aren't
+static Buffer<16> tiny;
+static Buffer<256> small;
+static Buffer<4096> large;
+
+int main() {
+    stress(tiny);
+    stress(small);
+    stress(large);
+    return MotateTest::testResult();
+}
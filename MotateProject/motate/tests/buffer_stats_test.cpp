@@ -0,0 +1,114 @@
+/*
+ buffer_stats_test.cpp - Check what the optional buffer statistics count
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define MOTATE_CONFIG_BUFFER_STATS 1
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+struct StatsOwner {
+    char *pos = nullptr;
+    uint32_t left = 0;
+    std::function<void()> done;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length, bool include_next = false) {
+        if (include_next) {
+            return false;
+        }
+        pos = buffer;
+        left = length;
+        return true;
+    };
+    char *getRXTransferPosition() { return pos; };
+
+    bool put(const char value) {
+        if (left == 0) {
+            return false;
+        }
+        *pos++ = value;
+        if (--left == 0) {
+            done();
+        }
+        return true;
+    };
+};
+
+// Buffer counts the values it refused
+void testDropped() {
+    Buffer<16> buffer;
+    for (uint32_t i = 0; i < 20; i++) {
+        buffer.write('x');
+    }
+    MOTATE_CHECK(buffer.dropped() == 5);
+    MOTATE_CHECK(buffer.peakFill() == 15);
+    MOTATE_CHECK(buffer.fullStalls() == 0);
+
+    buffer.resetStats();
+    MOTATE_CHECK(buffer.dropped() == 0);
+    MOTATE_CHECK(buffer.peakFill() == 0);
+}
+
+// RXBuffer never refuses a value itself -- the DMA just isn't restarted -- so it counts the
+// times it had to leave the DMA stopped, and nothing as dropped
+void testFullStalls() {
+    StatsOwner owner;
+    RXBuffer<64, StatsOwner*> buffer {&owner};
+    buffer.init();
+    buffer.read(); // starts the first transfer
+
+    uint32_t received = 0;
+    while (owner.put('x')) {
+        received++;
+    }
+    MOTATE_CHECK(received == 63);
+    MOTATE_CHECK(buffer.fullStalls() == 1);
+
+    // Every attempt to restart while it's still full is another stall
+    buffer.isFull();
+    buffer._restartTransfer();
+    buffer._restartTransfer();
+    MOTATE_CHECK(buffer.fullStalls() == 3);
+    MOTATE_CHECK(buffer.dropped() == 0);
+
+    // Handing space back makes room, and the DMA goes again
+    RXBuffer<64, StatsOwner*>::index_type length;
+    buffer.readSpan(length);
+    buffer.consume(length);
+    MOTATE_CHECK(owner.left > 0);
+    MOTATE_CHECK(buffer.fullStalls() == 3);
+}
+
+int main() {
+    testDropped();
+    testFullStalls();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,186 @@
+/*
+ buffer_timestamps_test.cpp - Check the RXBuffer receive timestamps
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define MOTATE_CONFIG_BUFFER_TIMESTAMPS 1
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+#include <deque>
+
+using namespace Motate;
+
+// The test moves the clock by hand
+static uint32_t now = 0;
+uint32_t testClock() { return now; };
+
+struct StampOwner {
+    char *pos = nullptr;
+    uint32_t left = 0;
+    std::function<void()> done;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length, bool include_next = false) {
+        if (include_next) {
+            return false;
+        }
+        pos = buffer;
+        left = length;
+        return true;
+    };
+    char *getRXTransferPosition() { return pos; };
+
+    bool put(const char value) {
+        if (left == 0) {
+            return false;
+        }
+        *pos++ = value;
+        if (--left == 0) {
+            done();
+        }
+        return true;
+    };
+};
+
+struct TestRandom {
+    uint32_t seed = 1;
+    uint32_t next(const uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+};
+
+// Bursts arrive at known times, each followed by a restart (as a read would do) to take a
+// mark. Every value's age has to be measured from the time of its own burst -- not a neighbour's
+// -- all the way around the buffer many times, so the offsets and the marks both wrap.
+template <uint32_t _size>
+void testAges() {
+    typedef RXBuffer<_size, StampOwner*> TestBuffer;
+    StampOwner owner;
+    TestBuffer buffer {&owner};
+    buffer.init();
+    buffer.read(); // starts the first transfer
+
+    struct Burst {
+        uint32_t count;
+        uint32_t time;
+    };
+    std::deque<Burst> bursts; // not yet read, oldest first
+    uint32_t waiting = 0;
+
+    TestRandom random;
+    uint8_t sent = 0, expected = 0;
+    uint32_t received = 0, errors = 0, wrong_ages = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+        now += 1 + random.next(50);
+
+        // Keep it well short of full, and within the marks, so every age is exact. (A burst
+        // can take two marks, if a transfer ends part way through it.)
+        uint32_t count = 1 + random.next(_size / 8);
+        if ((bursts.size() < 3) && (waiting + count < _size / 2)) {
+            for (uint32_t j = 0; j < count; j++) {
+                if (!owner.put(sent++)) {
+                    errors++;
+                }
+            }
+            buffer._restartTransfer();
+            bursts.push_back({count, now});
+            waiting += count;
+        }
+
+        now += random.next(20);
+
+        // The newest value, through age(offset)
+        if (waiting) {
+            typename TestBuffer::index_type newest = (buffer._read_offset + waiting - 1) & (_size - 1);
+            if (buffer.age(newest) != now - bursts.back().time) {
+                wrong_ages++;
+            }
+        }
+
+        // Then read some, checking frontAge() before each value
+        for (uint32_t reads = random.next(waiting + 1); reads; reads--) {
+            if (buffer.frontAge() != now - bursts.front().time) {
+                wrong_ages++;
+            }
+            if ((uint8_t)buffer.read() != expected++) {
+                errors++;
+            }
+            received++;
+            waiting--;
+            if (--bursts.front().count == 0) {
+                bursts.pop_front();
+            }
+        }
+    }
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(wrong_ages == 0);
+    MOTATE_CHECK(received > 20 * _size); // plenty of laps
+}
+
+// With more bursts waiting than there are marks, the ones past the last mark have to wait for
+// a later one (or the reader's first look). The ones with marks are still exact, and the rest
+// can only be too young (a lower bound), never older than they are.
+void testMarksFull() {
+    typedef RXBuffer<64, StampOwner*> TestBuffer;
+    StampOwner owner;
+    TestBuffer buffer {&owner};
+    buffer.init();
+    buffer.read();
+
+    uint32_t times[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        now += 100;
+        times[i] = now;
+        owner.put(i);
+        buffer._restartTransfer();
+    }
+    now += 1000;
+
+    uint32_t wrong_ages = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        now += 10;
+        uint32_t age = buffer.frontAge();
+        if ((i < 7) ? (age != now - times[i]) : (age > now - times[i])) {
+            wrong_ages++;
+        }
+        buffer.read();
+    }
+    MOTATE_CHECK(wrong_ages == 0);
+    MOTATE_CHECK(buffer.isEmpty());
+}
+
+int main() {
+    setBufferClock(testClock);
+    testAges<16>();
+    testAges<64>();
+    testAges<256>();
+    testMarksFull();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,93 @@
+/*
+ motate_test.h - Helpers for the host-built tests
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOTATE_TEST_H_ONCE
+#define MOTATE_TEST_H_ONCE
+
+// Just enough to write the host tests without pulling in a framework: MOTATE_CHECK() counts
+// (and reports) failures without stopping, and testResult() turns the count into the exit code.
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace MotateTest {
+    inline uint32_t &_failures() {
+        static uint32_t failures = 0;
+        return failures;
+    };
+
+    inline bool _check(const bool ok, const char *expr, const char *file, const int line) {
+        if (!ok) {
+            if (_failures()++ < 20) {
+                printf("%s:%d: check failed: %s\n", file, line, expr);
+            }
+        }
+        return ok;
+    };
+
+    inline int testResult() {
+        if (_failures()) {
+            printf("  FAILED (%u)\n", _failures());
+            return 1;
+        }
+        printf("  ok\n");
+        return 0;
+    };
+
+    // For the benchmarks: cycles where the host has a cycle counter (the TSC on x86), and
+    // nanoseconds elsewhere. Either way only the ratios between runs mean anything.
+    inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    };
+
+    inline const char *ticksName() {
+#if defined(__x86_64__) || defined(__i386__)
+        return "cycle";
+#else
+        return "ns";
+#endif
+    };
+
+    // Keep the optimizer from throwing away a result we only compute to time it.
+    template <typename T>
+    inline void keep(T const &value) { __asm__ __volatile__ ("" :: "g" (value) : "memory"); };
+} // namespace MotateTest
+
+#define MOTATE_CHECK(expr) MotateTest::_check((expr), #expr, __FILE__, __LINE__)
+
+#endif /* end of include guard: MOTATE_TEST_H_ONCE */
@@ -0,0 +1,228 @@
+/*
+ mptxbuffer_stress_test.cpp - Several threads write to one MPTXBuffer while another plays the DMA
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Counts dropped() as well, which several writers add to at once
+#define MOTATE_CONFIG_BUFFER_STATS 1
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace Motate;
+
+// Three producer threads stand in for the main loop and interrupts, each writing whole messages
+// to the same MPTXBuffer -- half with write_nb(), and half with reserve(), fill() and commit(),
+// poisoning the claim first and yielding before filling it, to hold the claim open as long as
+// possible. The main thread plays the DMA: it sends a byte at a time from whatever transfer it
+// was given, and calls the transfer-done callback at the end of each.
+//
+// Each message is a header (producer, sequence number, length), a payload worked out from
+// those, and a '\n'. The "DMA" parses everything it sends, so if a message were interleaved with
+// another, or if it were sent any of a claim before that claim was committed, it would see it.
+// Each producer's messages must also come out in the order it wrote them.
+//
+// The producers also count how much they had refused (write_nb() or reserve() finding no room),
+// which must match dropped() exactly.
+
+static constexpr uint32_t kProducers = 3;
+static constexpr uint32_t kMessages = 100000; // per producer
+static constexpr uint8_t kMaxPayload = 16;
+static constexpr uint8_t kPoison = 0xEE;
+
+// The owner_type, with the transfer position and length shared between threads
+struct ThreadedTXOwner {
+    std::atomic<char *> tx_pos {nullptr};
+    std::atomic<uint32_t> tx_left {0};
+    std::function<void()> tx_done;
+
+    void setTXTransferDoneCallback(std::function<void()> &&callback) { tx_done = std::move(callback); };
+    bool startTXTransfer(char *buffer, const uint16_t length) {
+        tx_pos.store(buffer, std::memory_order_release);
+        tx_left.store(length, std::memory_order_release);
+        return true;
+    };
+    char *getTXTransferPosition() { return tx_pos.load(std::memory_order_acquire); };
+};
+
+uint8_t payloadLength(const uint32_t producer, const uint32_t sequence) {
+    return 1 + ((sequence * 13 + producer) % kMaxPayload);
+}
+
+uint8_t payloadValue(const uint32_t producer, const uint32_t sequence, const uint32_t i) {
+    return (uint8_t)(sequence * 7 + i * 3 + producer);
+}
+
+// Checks the stream as it's sent, a byte at a time
+struct MessageChecker {
+    uint32_t next_sequence[kProducers] = {};
+    uint32_t messages = 0;
+    uint32_t errors = 0;
+
+    uint8_t state = 0; // 0 producer, 1 sequence, 2 length, 3 payload, 4 '\n'
+    uint32_t producer = 0;
+    uint8_t length = 0;
+    uint8_t position = 0;
+
+    void check(const uint8_t value) {
+        switch (state) {
+            case 0:
+                producer = value - 'A';
+                if (producer >= kProducers) {
+                    errors++;
+                    producer = 0;
+                }
+                state = 1;
+                break;
+            case 1:
+                if (value != (uint8_t)next_sequence[producer]) {
+                    errors++;
+                }
+                state = 2;
+                break;
+            case 2:
+                length = value;
+                if (length != payloadLength(producer, next_sequence[producer])) {
+                    errors++;
+                    length = 1;
+                }
+                position = 0;
+                state = 3;
+                break;
+            case 3:
+                if (value != payloadValue(producer, next_sequence[producer], position)) {
+                    errors++;
+                }
+                if (++position == length) {
+                    state = 4;
+                }
+                break;
+            case 4:
+                if (value != '\n') {
+                    errors++;
+                }
+                next_sequence[producer]++;
+                messages++;
+                state = 0;
+                break;
+        }
+    };
+};
+
+template <uint32_t _size>
+void stress(MPTXBuffer<_size, ThreadedTXOwner *> &buffer, ThreadedTXOwner &owner) {
+    typedef typename MPTXBuffer<_size, ThreadedTXOwner *>::index_type index_t;
+    buffer.init();
+    buffer.resetStats();
+
+    std::atomic<uint32_t> refused {0};
+    std::atomic<uint32_t> finished {0};
+    std::thread producers[kProducers];
+    for (uint32_t p = 0; p < kProducers; p++) {
+        producers[p] = std::thread([&buffer, &refused, &finished, p] {
+            char message[kMaxPayload + 4];
+            uint32_t my_refused = 0;
+            for (uint32_t sequence = 0; sequence < kMessages; sequence++) {
+                const uint8_t payload = payloadLength(p, sequence);
+                const index_t length = payload + 4;
+                message[0] = 'A' + p;
+                message[1] = (char)sequence;
+                message[2] = payload;
+                for (uint8_t i = 0; i < payload; i++) {
+                    message[3 + i] = payloadValue(p, sequence, i);
+                }
+                message[3 + payload] = '\n';
+
+                if (sequence & 1) {
+                    while (buffer.write_nb(message, length) == 0) {
+                        my_refused += length;
+                        std::this_thread::yield();
+                    }
+                } else {
+                    index_t start;
+                    while (!buffer.reserve(length, start)) {
+                        my_refused += length;
+                        std::this_thread::yield();
+                    }
+                    for (index_t i = 0; i < length; i++) {
+                        buffer.at(start, i) = kPoison;
+                    }
+                    std::this_thread::yield();
+                    buffer.fill(start, 0, message, length);
+                    buffer.commit();
+                }
+            }
+            refused += my_refused;
+            finished++;
+        });
+    }
+
+    // The "DMA" -- it keeps sending until the producers are done and there's nothing left, even
+    // if what it's sending is wrong, so the producers never wait forever for room
+    MessageChecker checker;
+    while (true) {
+        uint32_t left = owner.tx_left.load(std::memory_order_acquire);
+        if (left == 0) {
+            if ((finished.load() == kProducers) && buffer.isEmpty()) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        char *pos = owner.tx_pos.load(std::memory_order_acquire);
+        checker.check((uint8_t)*pos);
+        owner.tx_pos.store(pos + 1, std::memory_order_release);
+        owner.tx_left.store(left - 1, std::memory_order_release);
+        if (left == 1) {
+            owner.tx_done();
+        }
+    }
+
+    for (uint32_t p = 0; p < kProducers; p++) {
+        producers[p].join();
+    }
+    MOTATE_CHECK(checker.errors == 0);
+    MOTATE_CHECK(checker.messages == kProducers * kMessages);
+    MOTATE_CHECK(buffer.isEmpty());
+    MOTATE_CHECK(owner.tx_left.load() == 0);
+    MOTATE_CHECK(buffer.dropped() == refused.load());
+}
+
+// Small enough that the writers are nearly always waiting on each other and the "DMA", and big
+// enough that they mostly aren't
+static ThreadedTXOwner small_owner, large_owner;
+static MPTXBuffer<64, ThreadedTXOwner *> small {&small_owner};
+static MPTXBuffer<4096, ThreadedTXOwner *> large {&large_owner};
+
+int main() {
+    stress(small, small_owner);
+    stress(large, large_owner);
+    return MotateTest::testResult();
+}
@@ -0,0 +1,113 @@
+/*
+ recordqueue_bench.cpp - Compare the ways of moving records through a RecordQueue
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Moves the same 16-byte records through a queue of 256 in bursts of 64, three ways: one at a
+// time with try_push()/try_pop(), in batches with push()/pop(), and (for comparison with what we
+// had to do before) a byte at a time through a Buffer<4096>.
+
+struct Segment {
+    uint32_t sequence;
+    float velocity;
+    uint32_t steps;
+    uint32_t flags;
+};
+
+static constexpr uint32_t kRecords = 4UL * 1024 * 1024;
+static constexpr uint32_t kBurst = 64;
+
+static RecordQueue<256, Segment> queue;
+static Buffer<4096> bytes;
+static Segment source[kBurst];
+static Segment dest[kBurst];
+
+uint64_t runSingle() {
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t moved = 0; moved < kRecords; moved += kBurst) {
+        for (uint32_t i = 0; i < kBurst; i++) {
+            queue.try_push(source[i]);
+        }
+        for (uint32_t i = 0; i < kBurst; i++) {
+            queue.try_pop(dest[i]);
+        }
+        MotateTest::keep(dest);
+    }
+    return MotateTest::ticks() - start;
+}
+
+uint64_t runBatch() {
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t moved = 0; moved < kRecords; moved += kBurst) {
+        queue.push(source, kBurst);
+        queue.pop(dest, kBurst);
+        MotateTest::keep(dest);
+    }
+    return MotateTest::ticks() - start;
+}
+
+uint64_t runBytes() {
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t moved = 0; moved < kRecords; moved += kBurst) {
+        for (uint32_t i = 0; i < kBurst; i++) {
+            const char *from = (const char *)&source[i];
+            for (uint32_t j = 0; j < sizeof(Segment); j++) {
+                bytes.write(from[j]);
+            }
+        }
+        for (uint32_t i = 0; i < kBurst; i++) {
+            char *to = (char *)&dest[i];
+            for (uint32_t j = 0; j < sizeof(Segment); j++) {
+                to[j] = bytes.read();
+            }
+        }
+        MotateTest::keep(dest);
+    }
+    return MotateTest::ticks() - start;
+}
+
+int main() {
+    for (uint32_t i = 0; i < kBurst; i++) {
+        // No 0xFF bytes, so the byte-wise read() can't mistake one for -1 (empty)
+        source[i] = Segment {i, 1.0f, i * 3, 0x01020304};
+    }
+
+    uint64_t bytewise = runBytes();
+    uint64_t single = runSingle();
+    uint64_t batch = runBatch();
+
+    printf("  Buffer bytes:         %8.2f %ss/record\n", (double)bytewise / kRecords, MotateTest::ticksName());
+    printf("  try_push()/try_pop(): %8.2f %ss/record\n", (double)single / kRecords, MotateTest::ticksName());
+    printf("  push()/pop():         %8.2f %ss/record\n", (double)batch / kRecords, MotateTest::ticksName());
+
+    return memcmp(source, dest, sizeof(source)) ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+/*
+ recordqueue_test.cpp - Check RecordQueue, on one thread and on two
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+#include <thread>
+
+using namespace Motate;
+
+// Something shaped like a step segment: a mix of sizes, and no padding games
+struct Segment {
+    uint32_t sequence;
+    float velocity;
+    uint16_t steps;
+    uint8_t motor;
+};
+
+bool isSegment(const Segment &segment, const uint32_t sequence) {
+    return (segment.sequence == sequence) && (segment.velocity == (float)sequence) &&
+           (segment.steps == (uint16_t)sequence) && (segment.motor == (uint8_t)(sequence % 6));
+}
+
+Segment makeSegment(const uint32_t sequence) {
+    return Segment {sequence, (float)sequence, (uint16_t)sequence, (uint8_t)(sequence % 6)};
+}
+
+void testSingle() {
+    RecordQueue<8, Segment> queue;
+    Segment segment;
+
+    MOTATE_CHECK(queue.size() == 7);
+    MOTATE_CHECK(queue.isEmpty());
+    MOTATE_CHECK(queue.front() == nullptr);
+    MOTATE_CHECK(!queue.try_pop(segment));
+
+    // It holds _size-1
+    for (uint32_t i = 0; i < 7; i++) {
+        MOTATE_CHECK(queue.try_push(makeSegment(i)));
+    }
+    MOTATE_CHECK(queue.isFull());
+    MOTATE_CHECK(queue.count() == 7);
+    MOTATE_CHECK(queue.emplace() == nullptr);
+    MOTATE_CHECK(!queue.try_push(makeSegment(99)));
+
+    // In place, from the front
+    MOTATE_CHECK(queue.front() != nullptr && isSegment(*queue.front(), 0));
+    queue.consume();
+    MOTATE_CHECK(queue.try_pop(segment) && isSegment(segment, 1));
+
+    // In place, at the back (wrapping around to the beginning)
+    Segment *slot = queue.emplace();
+    MOTATE_CHECK(slot == queue._data + 7);
+    *slot = makeSegment(7);
+    queue.commit();
+    slot = queue.emplace();
+    MOTATE_CHECK(slot == queue._data);
+    *slot = makeSegment(8);
+    queue.commit();
+    MOTATE_CHECK(queue.isFull());
+
+    // A batch pop across the wrap comes out in order (two spans, so two copies)
+    Segment batch[10];
+    MOTATE_CHECK(queue.pop(batch, 10) == 7);
+    for (uint32_t i = 0; i < 7; i++) {
+        MOTATE_CHECK(isSegment(batch[i], i + 2));
+    }
+    MOTATE_CHECK(queue.isEmpty());
+
+    // ... and so does a batch push, which stops when it's full
+    for (uint32_t i = 0; i < 10; i++) {
+        batch[i] = makeSegment(100 + i);
+    }
+    MOTATE_CHECK(queue.push(batch, 10) == 7);
+    MOTATE_CHECK(queue.push(batch, 10) == 0);
+    for (uint32_t i = 0; i < 7; i++) {
+        MOTATE_CHECK(queue.try_pop(segment) && isSegment(segment, 100 + i));
+    }
+
+    // Spans hand out the records in place
+    RecordQueue<8, Segment>::index_type length;
+    Segment *span = queue.reserve(length);
+    MOTATE_CHECK(length > 0);
+    span[0] = makeSegment(200);
+    queue.commit(1);
+    span = queue.readSpan(length);
+    MOTATE_CHECK(length == 1 && isSegment(span[0], 200));
+    queue.consume(length);
+    MOTATE_CHECK(queue.isEmpty());
+}
+
+// A producer and a consumer on two threads, with no pacing between them, mixing the single and
+// batch calls. Every record has to arrive whole and in order.
+void testThreaded() {
+    static RecordQueue<64, Segment> queue;
+    static constexpr uint32_t kRecords = 2000000;
+
+    std::thread producer([] {
+        Segment batch[7];
+        for (uint32_t i = 0; i < kRecords; ) {
+            uint32_t pushed;
+            if (i % 3) {
+                uint32_t count = 0;
+                for (; (count < 7) && (i + count < kRecords); count++) {
+                    batch[count] = makeSegment(i + count);
+                }
+                pushed = queue.push(batch, count);
+            } else {
+                pushed = queue.try_push(makeSegment(i)) ? 1 : 0;
+            }
+            i += pushed;
+            if (!pushed) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t errors = 0;
+    Segment batch[5];
+    for (uint32_t i = 0; i < kRecords; ) {
+        uint32_t popped = queue.pop(batch, 5);
+        for (uint32_t j = 0; j < popped; j++) {
+            if (!isSegment(batch[j], i + j)) {
+                errors++;
+            }
+        }
+        i += popped;
+
+        Segment *front = queue.front();
+        if (front) {
+            if (!isSegment(*front, i)) {
+                errors++;
+            }
+            queue.consume();
+            i++;
+            popped++;
+        }
+        if (!popped) {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(queue.isEmpty());
+}
+
+int main() {
+    testSingle();
+    testThreaded();
+    return MotateTest::testResult();
+}
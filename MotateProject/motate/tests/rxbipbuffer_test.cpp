@@ -0,0 +1,173 @@
+/*
+ rxbipbuffer_test.cpp - Check the wrap handling of RXBipBuffer
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Stands in for a DMA-capable peripheral. The test decides when "the DMA" writes a byte, with
+// put(), and the transfer-done callback is called just like the interrupt would.
+struct BipOwner {
+    char *pos = nullptr;
+    uint32_t left = 0;
+    uint32_t started = 0;
+    uint32_t last_length = 0;
+    std::function<void()> done;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length) {
+        pos = buffer;
+        left = length;
+        last_length = length;
+        started++;
+        return true;
+    };
+    char *getRXTransferPosition() { return pos; };
+
+    bool put(const char value) {
+        if (left == 0) {
+            return false;
+        }
+        *pos++ = value;
+        if (--left == 0) {
+            done();
+        }
+        return true;
+    };
+};
+
+struct TestRandom {
+    uint32_t seed = 1;
+    uint32_t next(const uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+};
+
+// Walk one buffer through a wrap by hand, checking each block and span against the picture
+// in the RXBipBuffer comments
+void testWrap() {
+    BipOwner owner;
+    RXBipBuffer<100, BipOwner*> buffer {&owner};
+    RXBipBuffer<100, BipOwner*>::index_type length;
+    buffer.init();
+
+    // Not a power of two, and the whole thing is handed out at once
+    buffer.readSpan(length);
+    MOTATE_CHECK(length == 0);
+    MOTATE_CHECK(owner.started == 1);
+    MOTATE_CHECK(owner.pos == buffer._data);
+    MOTATE_CHECK(owner.last_length == 100);
+
+    for (uint32_t i = 0; i < 100; i++) {
+        MOTATE_CHECK(owner.put(i));
+    }
+    MOTATE_CHECK(!owner.put(0)); // full, and the DMA was left stopped
+    MOTATE_CHECK(owner.started == 1);
+
+    char *span = buffer.readSpan(length);
+    MOTATE_CHECK(span == buffer._data);
+    MOTATE_CHECK(length == 100);
+
+    // Reading 60 frees 59 at the beginning (one is kept back so full doesn't look like empty)
+    // and nothing at the end, so the next block wraps
+    buffer.consume(60);
+    MOTATE_CHECK(owner.started == 2);
+    MOTATE_CHECK(owner.pos == buffer._data);
+    MOTATE_CHECK(owner.last_length == 59);
+    MOTATE_CHECK(buffer._last.load() == 100);
+
+    for (uint32_t i = 100; i < 110; i++) {
+        MOTATE_CHECK(owner.put(i));
+    }
+
+    // The tail comes first, and stops at the watermark ...
+    span = buffer.readSpan(length);
+    MOTATE_CHECK(span == buffer._data + 60);
+    MOTATE_CHECK(length == 40);
+    MOTATE_CHECK(span[0] == 60);
+    buffer.consume(40);
+
+    // ... then the reader wraps to the new data at the beginning
+    span = buffer.readSpan(length);
+    MOTATE_CHECK(span == buffer._data);
+    MOTATE_CHECK(length == 10);
+    MOTATE_CHECK(span[0] == 100);
+    buffer.consume(10);
+
+    buffer.readSpan(length);
+    MOTATE_CHECK(length == 0);
+    MOTATE_CHECK(owner.started == 2); // the wrapped block is still running
+}
+
+// Random bursts of DMA writes and reads of random length, checking the order of every byte
+template <uint32_t _size>
+void testRandom() {
+    BipOwner owner;
+    RXBipBuffer<_size, BipOwner*> buffer {&owner};
+    typename RXBipBuffer<_size, BipOwner*>::index_type length;
+    buffer.init();
+    buffer.readSpan(length);
+
+    TestRandom random;
+    uint8_t sent = 0, expected = 0;
+    uint32_t received = 0, errors = 0;
+    for (uint32_t i = 0; i < 200000; i++) {
+        for (uint32_t burst = random.next(_size / 2 + 2); burst; burst--) {
+            if (owner.put(sent)) {
+                sent++;
+            }
+        }
+
+        char *span = buffer.readSpan(length);
+        if (length) {
+            length = 1 + random.next(length);
+            for (uint32_t j = 0; j < length; j++) {
+                if ((uint8_t)span[j] != expected) {
+                    errors++;
+                }
+                expected = span[j] + 1;
+            }
+            buffer.consume(length);
+            received += length;
+        }
+    }
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(received > 200000);
+}
+
+int main() {
+    testWrap();
+    testRandom<10>();
+    testRandom<100>();
+    testRandom<300>();
+    testRandom<1024>();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,238 @@
+/*
+ rxbuffer_lines_bench.cpp - Compare parsing lines with the RXBuffer line index against a read() loop
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Parses the same 100k lines (G-code-ish, 8 to 40 bytes) out of an RXBuffer<1024> three ways:
+//  - a read() loop that copies each byte out until the newline
+//  - checking for a complete line by scanning everything waiting each time more arrives (what
+//    the application does now, so it only starts on a line once it's all there), then read()ing
+//    it out
+//  - in place, with linesAvailable() and readLineSpan()
+// "The DMA" here is a memcpy of up to 16 bytes (like a UART FIFO's worth) into whatever transfer
+// is running, done whenever the reader finds nothing new.
+
+static constexpr uint32_t kLines = 100000;
+
+struct BenchOwner {
+    char *pos = nullptr;
+    uint32_t left = 0;
+    std::function<void()> done;
+
+    const char *source = nullptr;
+    uint32_t source_left = 0;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length, bool include_next = false) {
+        if (include_next) {
+            return false;
+        }
+        pos = buffer;
+        left = length;
+        return true;
+    };
+    char *getRXTransferPosition() { return pos; };
+
+    // Deliver up to 16 bytes of the source, as far as the running transfer (and the ones after
+    // it) will take them
+    void deliver() {
+        uint32_t chunk = 16;
+        while (chunk && left && source_left) {
+            uint32_t length = (left < source_left) ? left : source_left;
+            if (length > chunk) {
+                length = chunk;
+            }
+            chunk -= length;
+            memcpy(pos, source, length);
+            pos += length;
+            source += length;
+            source_left -= length;
+            left -= length;
+            if (left == 0) {
+                done();
+            }
+        }
+    };
+};
+
+static char text[kLines * 40];
+static uint32_t text_length = 0;
+
+typedef RXBuffer<1024, BenchOwner*> BenchBuffer;
+
+// A stand-in for the real parser: something that has to look at every byte of the line
+uint32_t parseLine(const char *line, const uint32_t length, uint32_t checksum) {
+    for (uint32_t i = 0; i < length; i++) {
+        checksum = (checksum << 1) ^ line[i];
+    }
+    return checksum;
+}
+
+uint64_t runReadLoop(uint32_t &lines, uint32_t &checksum) {
+    BenchOwner owner;
+    BenchBuffer buffer {&owner};
+    buffer.init();
+    owner.source = text;
+    owner.source_left = text_length;
+
+    char line[64];
+    uint32_t line_length = 0;
+    lines = 0;
+    checksum = 0;
+
+    uint64_t start = MotateTest::ticks();
+    while (lines < kLines) {
+        int16_t value = buffer.read();
+        if (value < 0) {
+            owner.deliver();
+            continue;
+        }
+        line[line_length++] = value;
+        if (value == '\n') {
+            checksum = parseLine(line, line_length, checksum);
+            line_length = 0;
+            lines++;
+        }
+    }
+    return MotateTest::ticks() - start;
+}
+
+uint64_t runRescan(uint32_t &lines, uint32_t &checksum) {
+    BenchOwner owner;
+    BenchBuffer buffer {&owner};
+    buffer.init();
+    owner.source = text;
+    owner.source_left = text_length;
+
+    char line[64];
+    lines = 0;
+    checksum = 0;
+
+    uint64_t start = MotateTest::ticks();
+    buffer.read(); // starts the first transfer
+    while (lines < kLines) {
+        // Is there a whole line yet? (Up to two spans, if it wraps.)
+        bool found = false;
+        BenchBuffer::index_type length;
+        char *span = buffer.readSpan(length);
+        for (uint32_t i = 0; (i < length) && !found; i++) {
+            found = (span[i] == '\n');
+        }
+        if (!found && length && (span + length == buffer._data + 1024)) {
+            span = buffer._data;
+            length = buffer._last_known_write_offset;
+            for (uint32_t i = 0; (i < length) && !found; i++) {
+                found = (span[i] == '\n');
+            }
+        }
+        if (!found) {
+            owner.deliver();
+            continue;
+        }
+
+        uint32_t line_length = 0;
+        int16_t value;
+        do {
+            value = buffer.read();
+            line[line_length++] = value;
+        } while (value != '\n');
+        checksum = parseLine(line, line_length, checksum);
+        lines++;
+    }
+    return MotateTest::ticks() - start;
+}
+
+uint64_t runLineIndex(uint32_t &lines, uint32_t &checksum) {
+    BenchOwner owner;
+    BenchBuffer buffer {&owner};
+    buffer.init();
+    owner.source = text;
+    owner.source_left = text_length;
+
+    char line[64];
+    lines = 0;
+    checksum = 0;
+
+    uint64_t start = MotateTest::ticks();
+    buffer.read(); // starts the first transfer
+    while (lines < kLines) {
+        if (!buffer.linesAvailable()) {
+            owner.deliver();
+            continue;
+        }
+
+        BenchBuffer::index_type length;
+        char *span = buffer.readLineSpan(length);
+        if (span[length - 1] == '\n') {
+            // The usual case: parse it right where the DMA put it
+            checksum = parseLine(span, length, checksum);
+        } else {
+            // It wrapped the end of the buffer, so it comes in two pieces
+            memcpy(line, span, length);
+            buffer.consume(length);
+            BenchBuffer::index_type rest;
+            span = buffer.readLineSpan(rest);
+            memcpy(line + length, span, rest);
+            checksum = parseLine(line, length + rest, checksum);
+            length = rest;
+        }
+        buffer.consume(length);
+        lines++;
+    }
+    return MotateTest::ticks() - start;
+}
+
+int main() {
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < kLines; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t length = 8 + (seed >> 16) % 32;
+        text[text_length++] = 'G';
+        for (uint32_t j = 1; j < length; j++) {
+            text[text_length++] = '0' + (seed + j) % 10;
+        }
+        text[text_length++] = '\n';
+    }
+
+    uint32_t lines_read, checksum_read, lines_rescan, checksum_rescan, lines_index, checksum_index;
+    uint64_t read_loop = runReadLoop(lines_read, checksum_read);
+    uint64_t rescan = runRescan(lines_rescan, checksum_rescan);
+    uint64_t line_index = runLineIndex(lines_index, checksum_index);
+
+    printf("  read() loop:     %8.1f %ss/line\n", (double)read_loop / kLines, MotateTest::ticksName());
+    printf("  rescan + read(): %8.1f %ss/line\n", (double)rescan / kLines, MotateTest::ticksName());
+    printf("  line index:      %8.1f %ss/line (%.1fx faster than rescan)\n", (double)line_index / kLines, MotateTest::ticksName(), (double)rescan / line_index);
+
+    // They all have to have seen exactly the same lines
+    return ((lines_read == lines_index) && (checksum_read == checksum_index) &&
+            (lines_rescan == lines_index) && (checksum_rescan == checksum_index)) ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/*
+ rxbuffer_lines_test.cpp - Check the RXBuffer line index
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+#include <string>
+
+using namespace Motate;
+
+// Stands in for a DMA-capable peripheral, without the "next" registers. The test decides when
+// "the DMA" writes a byte, with put(), and the transfer-done callback is called just like the
+// interrupt would.
+struct LineOwner {
+    char *pos = nullptr;
+    uint32_t left = 0;
+    std::function<void()> done;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+    bool startRXTransfer(char *&buffer, const uint16_t length, bool include_next = false) {
+        if (include_next) {
+            return false;
+        }
+        pos = buffer;
+        left = length;
+        return true;
+    };
+    char *getRXTransferPosition() { return pos; };
+
+    bool put(const char value) {
+        if (left == 0) {
+            return false;
+        }
+        *pos++ = value;
+        if (--left == 0) {
+            done();
+        }
+        return true;
+    };
+};
+
+struct TestRandom {
+    uint32_t seed = 1;
+    uint32_t next(const uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+};
+
+// The n-th value of an endless stream of lines of 1 to 12 values
+char lineStream(const uint32_t n) {
+    uint32_t line_length = 1 + ((n / 13) * 7) % 12;
+    return ((n % 13) >= line_length - 1) ? '\n' : 'a' + (n % 26);
+}
+
+typedef RXBuffer<256, LineOwner*> LineBuffer;
+
+// Is line "nn\n", for the number n?
+bool isNumberedLine(const std::string &line, const uint32_t n) {
+    return (line.size() == 3) && (line[0] == (char)('0' + n / 10)) && (line[1] == (char)('0' + n % 10)) && (line[2] == '\n');
+}
+
+// Read the next line (in up to two spans) into line
+void readLine(LineBuffer &buffer, std::string &line) {
+    line.clear();
+    LineBuffer::index_type length;
+    do {
+        char *span = buffer.readLineSpan(length);
+        line.append(span, length);
+        buffer.consume(length);
+    } while (length && (line.back() != '\n'));
+}
+
+// Many more lines waiting than _line_index_size, and the count has to stay exact as they're
+// read, and as they're skipped over with plain readSpan/consume.
+void testCount() {
+    LineOwner owner;
+    LineBuffer buffer {&owner};
+    buffer.init();
+    buffer.isEmpty();
+    buffer.read(); // starts the first transfer
+
+    MOTATE_CHECK(buffer.linesAvailable() == 0);
+    MOTATE_CHECK(buffer.lineLength() == 0);
+
+    // 40 lines of "xx\n" and one without its newline yet
+    for (uint32_t i = 0; i < 40; i++) {
+        owner.put('0' + i / 10);
+        owner.put('0' + i % 10);
+        owner.put('\n');
+    }
+    owner.put('!');
+    MOTATE_CHECK(buffer.linesAvailable() == 40);
+
+    std::string line;
+    for (uint32_t i = 0; i < 20; i++) {
+        MOTATE_CHECK(buffer.lineLength() == 3);
+        readLine(buffer, line);
+        MOTATE_CHECK(isNumberedLine(line, i));
+        MOTATE_CHECK(buffer.linesAvailable() == 39 - i);
+    }
+
+    // Skip 5 lines and part of the next without the line calls
+    LineBuffer::index_type length;
+    buffer.readSpan(length);
+    MOTATE_CHECK(length >= 16);
+    buffer.consume(16);
+    MOTATE_CHECK(buffer.linesAvailable() == 15);
+    readLine(buffer, line);
+    MOTATE_CHECK(line == "5\n");
+
+    for (uint32_t i = 26; i < 40; i++) {
+        readLine(buffer, line);
+        MOTATE_CHECK(isNumberedLine(line, i));
+    }
+    MOTATE_CHECK(buffer.linesAvailable() == 0);
+    owner.put('\n');
+    MOTATE_CHECK(buffer.linesAvailable() == 1);
+    readLine(buffer, line);
+    MOTATE_CHECK(line == "!\n");
+
+    // flush() forgets everything
+    owner.put('\n');
+    owner.put('\n');
+    MOTATE_CHECK(buffer.linesAvailable() == 2);
+    buffer.flush();
+    MOTATE_CHECK(buffer.linesAvailable() == 0);
+}
+
+// Random bursts of DMA writes, read back a line at a time (with an occasional byte or span read
+// mixed in), checking the count against one kept here and the content against the stream.
+void testRandom() {
+    LineOwner owner;
+    LineBuffer buffer {&owner};
+    buffer.init();
+    buffer.read();
+
+    TestRandom random;
+    uint32_t sent = 0, read = 0;
+    uint32_t lines_sent = 0, lines_read = 0;
+    uint32_t errors = 0;
+    std::string line;
+
+    for (uint32_t i = 0; i < 200000; i++) {
+        for (uint32_t burst = random.next(24); burst; burst--) {
+            if (owner.put(lineStream(sent))) {
+                if (lineStream(sent) == '\n') {
+                    lines_sent++;
+                }
+                sent++;
+            }
+        }
+
+        if (buffer.linesAvailable() != (lines_sent - lines_read)) {
+            errors++;
+        }
+
+        uint32_t action = random.next(8);
+        if (action == 0) {
+            int16_t value = buffer.read();
+            if (value >= 0) {
+                if (value != lineStream(read)) {
+                    errors++;
+                }
+                if (value == '\n') {
+                    lines_read++;
+                }
+                read++;
+            }
+        } else if (action == 1) {
+            LineBuffer::index_type length;
+            char *span = buffer.readSpan(length);
+            if (length) {
+                length = 1 + random.next(length);
+                for (uint32_t j = 0; j < length; j++) {
+                    if (span[j] != lineStream(read)) {
+                        errors++;
+                    }
+                    if (span[j] == '\n') {
+                        lines_read++;
+                    }
+                    read++;
+                }
+                buffer.consume(length);
+            }
+        } else if (buffer.linesAvailable()) {
+            readLine(buffer, line);
+            for (char c : line) {
+                if (c != lineStream(read)) {
+                    errors++;
+                }
+                read++;
+            }
+            lines_read++;
+        }
+    }
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(lines_read > 20000);
+}
+
+int main() {
+    testCount();
+    testRandom();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,321 @@
+/*
+ rxbuffer_pdc_test.cpp - Run RXBuffer against a simulated PDC with current and next registers
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// A model of a SAM UART with its PDC, as seen through UART::startRXTransfer() and
+// DMA_PDC::startRXTransfer() -- the current (RPR/RCR) and next (RNPR/RNCR) registers:
+//  - When RCR runs out the PDC moves the next registers into the current ones and raises ENDRX,
+//    or if there's nothing next it raises RXBUFF. Either way the interrupt calls the
+//    transfer-done callback, whenever the test gets around to service()ing it.
+//  - A byte that arrives with no transfer running is taken by the RX-ready interrupt into the
+//    16-byte overflow buffer (one interrupt per byte, which chaining is meant to avoid), and a
+//    new transfer takes those bytes first. While that's full RTS holds the sender off.
+//  - Without has_next it's an owner that can't chain: include_next requests are refused.
+template <bool has_next>
+struct PDCModel {
+    char *rpr = nullptr;
+    uint32_t rcr = 0;
+    char *rnpr = nullptr;
+    uint32_t rncr = 0;
+    char *manual_position = nullptr;
+    bool interrupt_pending = false;
+    std::function<void()> done;
+
+    char overflow[16];
+    uint8_t overflow_count = 0;
+
+    uint32_t rx_ready_interrupts = 0;
+    uint32_t done_interrupts = 0;
+    uint32_t longest_transfer = 0;
+
+    void setRXTransferDoneCallback(std::function<void()> &&callback) { done = std::move(callback); };
+
+    bool startRXTransfer(char *&buffer, uint16_t length, bool include_next = false) {
+        if (length > longest_transfer) {
+            longest_transfer = length;
+        }
+        if (include_next && rcr) {
+            if (!has_next || rncr) {
+                return false;
+            }
+            rnpr = buffer;
+            rncr = length;
+            return true;
+        }
+
+        // Nothing running, so whatever the RX-ready interrupt collected goes first
+        uint8_t drained = 0;
+        while ((drained < overflow_count) && length) {
+            *buffer++ = overflow[drained++];
+            length--;
+        }
+        memmove(overflow, overflow + drained, overflow_count - drained);
+        overflow_count -= drained;
+
+        if (length == 0) {
+            manual_position = buffer;
+            return false;
+        }
+        manual_position = nullptr;
+        rpr = buffer;
+        rcr = length;
+        return true;
+    };
+
+    char *getRXTransferPosition() { return manual_position ? manual_position : rpr; };
+
+    // A byte arrives on the wire. Returns false if RTS held it off.
+    bool receive(const char value) {
+        if (rcr) {
+            *rpr++ = value;
+            if (--rcr == 0) {
+                if (rncr) {
+                    rpr = rnpr;
+                    rcr = rncr;
+                    rncr = 0;
+                }
+                interrupt_pending = true; // ENDRX, or RXBUFF if there was nothing next
+            }
+            return true;
+        }
+        if (overflow_count == sizeof(overflow)) {
+            return false;
+        }
+        overflow[overflow_count++] = value;
+        rx_ready_interrupts++;
+        return true;
+    };
+
+    void service() {
+        if (interrupt_pending) {
+            interrupt_pending = false;
+            done_interrupts++;
+            done();
+        }
+    };
+};
+
+struct TestRandom {
+    uint32_t seed = 1;
+    uint32_t next(const uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+};
+
+struct PDCResult {
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint32_t rx_ready_interrupts = 0;
+    uint32_t done_interrupts = 0;
+};
+
+// Bytes arrive, the interrupt gets serviced late, and the reader reads in random bites, all in
+// random order. Every byte has to come out, in order. A slow reader lets the buffer fill up (so
+// the DMA has to stop no matter what), a fast one reads every other step and mostly keeps up.
+template <uint32_t _size, bool has_next>
+PDCResult run(const bool fast_reader, const uint32_t max_latency = 0) {
+    PDCModel<has_next> pdc;
+    RXBuffer<_size, PDCModel<has_next>*> buffer {&pdc};
+    typename RXBuffer<_size, PDCModel<has_next>*>::index_type length;
+    buffer.init();
+    buffer.readSpan(length); // starts the first transfer
+
+    TestRandom random;
+    PDCResult result;
+    uint8_t sent = 0, expected = 0;
+    uint32_t latency = 0;
+
+    for (uint32_t i = 0; i < 1000000; i++) {
+        uint32_t action = random.next(10);
+        if (fast_reader && (i & 1)) {
+            action = 9;
+        }
+        if (action < 5) {
+            if (pdc.receive(sent)) {
+                sent++;
+            }
+            if (max_latency && pdc.interrupt_pending && (++latency >= max_latency)) {
+                pdc.service();
+                latency = 0;
+            }
+        } else if (action < 7) {
+            pdc.service();
+            latency = 0;
+        } else {
+            char *span = buffer.readSpan(length);
+            if (length) {
+                length = 1 + random.next(length);
+                for (uint32_t j = 0; j < length; j++) {
+                    if ((uint8_t)span[j] != expected) {
+                        result.errors++;
+                    }
+                    expected = span[j] + 1;
+                }
+                buffer.consume(length);
+                result.received += length;
+            }
+        }
+    }
+
+    result.rx_ready_interrupts = pdc.rx_ready_interrupts;
+    result.done_interrupts = pdc.done_interrupts;
+    return result;
+}
+
+template <uint32_t _size>
+void compare(const bool fast_reader) {
+    PDCResult single = run<_size, false>(fast_reader);
+    PDCResult chained = run<_size, true>(fast_reader);
+
+    printf("  %4u bytes, %s reader: per-byte interrupts %6u -> %6u, transfer-done interrupts %6u -> %6u\n",
+           _size, fast_reader ? "fast" : "slow", single.rx_ready_interrupts, chained.rx_ready_interrupts,
+           single.done_interrupts, chained.done_interrupts);
+
+    MOTATE_CHECK(single.errors == 0);
+    MOTATE_CHECK(chained.errors == 0);
+    MOTATE_CHECK(single.received > 100000);
+    MOTATE_CHECK(chained.received > 100000);
+
+    // The point of the next registers: the DMA doesn't stop at the end of each chunk. (It still
+    // stops when the buffer is full, and here the interrupt can be any amount late, which
+    // testLatency() below doesn't allow.) A "next" chunk is queued before the reader has moved
+    // as far as it will have by the time the DMA gets there, so chunks are shorter and there
+    // are more transfer-done interrupts -- the price of never leaving the DMA without one.
+    MOTATE_CHECK((chained.rx_ready_interrupts < single.rx_ready_interrupts) || (chained.rx_ready_interrupts == 0));
+}
+
+// With the reader keeping up and the transfer-done interrupt never more than a few bytes late
+// -- fewer than RXBuffer's shortest "next" chunk -- there's always a chunk queued behind the
+// one that ended, long enough to last until the interrupt queues the one after it. So no byte
+// should ever have to be caught by the per-byte interrupt.
+template <uint32_t _size>
+void testLatency() {
+    const uint32_t latency = RXBuffer<_size, PDCModel<true>*>::_min_next_transfer - 1;
+    PDCResult chained = run<_size, true>(/*fast_reader =*/ true, latency);
+
+    printf("  %4u bytes, interrupt at most %2u bytes late: per-byte interrupts %u, transfer-done interrupts %u\n",
+           _size, latency, chained.rx_ready_interrupts, chained.done_interrupts);
+
+    MOTATE_CHECK(chained.errors == 0);
+    MOTATE_CHECK(chained.received > 100000);
+    MOTATE_CHECK(chained.rx_ready_interrupts == 0);
+}
+
+template <uint32_t _size>
+void compare() {
+    compare<_size>(false);
+    compare<_size>(true);
+}
+
+// Flow control marks (the XON/XOFF a BufferedUART sends). With the interrupt serviced after
+// every byte, the stop has to come on the byte that brings the fill to the high mark -- not
+// later, when the buffer is full -- and again on the next lap. The go has to wait for reads to
+// bring it under the low mark. The transfer limit (if any) has to hold every transfer to it.
+void testFlowControl(const uint32_t transfer_limit) {
+    PDCModel<true> pdc;
+    RXBuffer<256, PDCModel<true>*> buffer {&pdc};
+    RXBuffer<256, PDCModel<true>*>::index_type length;
+    buffer.init();
+
+    uint32_t stops = 0, goes = 0;
+    bool stopped = false;
+    buffer.setFlowControl(192, 64, [&](bool stop) {
+        stop ? stops++ : goes++;
+        stopped = stop;
+    });
+    buffer.setTransferLimit(transfer_limit);
+    buffer.readSpan(length); // starts the first transfer
+
+    uint8_t sent = 0, expected = 0;
+    uint32_t errors = 0;
+    auto receive = [&](uint32_t count) {
+        while (count--) {
+            MOTATE_CHECK(pdc.receive(sent++));
+            pdc.service();
+        }
+    };
+    auto read = [&](uint32_t count) {
+        while (count) {
+            char *span = buffer.readSpan(length);
+            if (length > count) {
+                length = count;
+            }
+            MOTATE_CHECK(length > 0);
+            for (uint32_t j = 0; j < length; j++) {
+                if ((uint8_t)span[j] != expected++) {
+                    errors++;
+                }
+            }
+            buffer.consume(length);
+            count -= length;
+        }
+    };
+
+    for (uint32_t lap = 0; lap < 4; lap++) {
+        // 64 waiting at the start of every lap but the first
+        uint32_t waiting = lap ? 63 : 0;
+        receive(191 - waiting);
+        MOTATE_CHECK(!stopped);
+        receive(1);
+        MOTATE_CHECK(stopped && (stops == lap + 1));
+
+        receive(40); // the other side takes a while to stop, and there's room for that
+        MOTATE_CHECK(pdc.rx_ready_interrupts == 0);
+        read(232 - 64);
+        MOTATE_CHECK(stopped);
+        read(1);
+        MOTATE_CHECK(!stopped && (goes == lap + 1));
+    }
+    MOTATE_CHECK(errors == 0);
+    if (transfer_limit) {
+        MOTATE_CHECK(pdc.longest_transfer <= transfer_limit);
+    }
+    MOTATE_CHECK(pdc.rx_ready_interrupts == 0);
+}
+
+int main() {
+    testFlowControl(0);
+    testFlowControl(30);
+    compare<16>();
+    compare<32>();
+    compare<64>();
+    compare<128>();
+    compare<256>();
+    compare<512>();
+    compare<1024>();
+    testLatency<64>();
+    testLatency<256>();
+    testLatency<1024>();
+    return MotateTest::testResult();
+}
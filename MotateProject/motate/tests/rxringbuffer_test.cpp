@@ -0,0 +1,198 @@
+/*
+ rxringbuffer_test.cpp - Check the wrap and overrun handling of RXRingBuffer
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "MotateBuffer.h"
+
+using namespace Motate;
+
+// Stands in for a DMA channel running a circular receive. The test decides when "the DMA"
+// writes a byte, with put(). Like the XDMAC, the position can be left pointing just past the
+// end after a lap, until the next byte comes in.
+struct RingOwner {
+    char *base = nullptr;
+    char *pos = nullptr;
+    uint32_t length = 0;
+    bool refuse = false;
+    bool park_at_end = false;
+    uint32_t started = 0;
+    uint32_t stopped = 0;
+
+    bool startRXRing(char *buffer, const uint32_t ring_length) {
+        if (refuse) {
+            return false;
+        }
+        base = pos = buffer;
+        length = ring_length;
+        started++;
+        return true;
+    };
+    void stopRXRing() { stopped++; };
+    char *getRXTransferPosition() { return pos; };
+
+    void put(const char value) {
+        if (pos == base + length) {
+            pos = base;
+        }
+        *pos++ = value;
+        if ((pos == base + length) && !park_at_end) {
+            pos = base;
+        }
+    };
+};
+
+typedef RXRingBuffer<16, RingOwner*> TestRing;
+
+// Around the ring a few times, reading across the wrap, with the position both wrapped and
+// parked at the end
+void testWrap(const bool park_at_end) {
+    RingOwner owner;
+    owner.park_at_end = park_at_end;
+    TestRing buffer {&owner};
+    TestRing::index_type length;
+
+    // Nothing is there before it's started
+    MOTATE_CHECK(buffer.isEmpty());
+    MOTATE_CHECK(buffer.read() == -1);
+
+    MOTATE_CHECK(buffer.init());
+    MOTATE_CHECK(owner.started == 1);
+    MOTATE_CHECK(buffer.isRunning());
+    MOTATE_CHECK(buffer.isEmpty());
+
+    uint8_t sent = 0, expected = 0;
+    uint32_t errors = 0;
+    for (uint32_t lap = 0; lap < 5; lap++) {
+        // 11 at a time, so the reads land all over the ring
+        for (uint32_t i = 0; i < 11; i++) {
+            owner.put(sent++);
+        }
+        MOTATE_CHECK(buffer.count() == 11);
+
+        // At most two spans: up to the end, then from the beginning
+        uint32_t spans = 0;
+        char *span;
+        while ((span = buffer.readSpan(length)), length) {
+            MOTATE_CHECK(span + length <= buffer._data + 16);
+            for (uint32_t j = 0; j < length; j++) {
+                if ((uint8_t)span[j] != expected++) {
+                    errors++;
+                }
+            }
+            buffer.consume(length);
+            spans++;
+        }
+        MOTATE_CHECK(spans == 1 || spans == 2);
+        MOTATE_CHECK(buffer.isEmpty());
+    }
+    MOTATE_CHECK(errors == 0);
+    MOTATE_CHECK(expected == 55);
+
+    // Exactly to the end of the ring: a parked position is the same as the beginning
+    while (buffer._read_offset + buffer.count() != 16) {
+        owner.put(sent++);
+    }
+    MOTATE_CHECK(owner.pos == buffer._data + (park_at_end ? 16 : 0));
+    while (!buffer.isEmpty()) {
+        MOTATE_CHECK(buffer.read() == (char)expected++);
+    }
+    MOTATE_CHECK(buffer._read_offset == 0);
+    owner.put(sent++);
+    MOTATE_CHECK(buffer.peek() == (char)expected);
+    MOTATE_CHECK(buffer.count() == 1);
+
+    buffer.stop();
+    buffer.stop();
+    MOTATE_CHECK(owner.stopped == 1);
+    MOTATE_CHECK(!buffer.isRunning());
+}
+
+// Nothing holds the DMA back, so a reader that falls a lap behind loses data. A full lap looks
+// like nothing at all, and more than a lap looks like just the extra -- the newest data, at the
+// reader's position. flush() is how to get back in step.
+void testOverrun() {
+    RingOwner owner;
+    TestRing buffer {&owner};
+    buffer.init();
+
+    // One short of a lap is all still there
+    for (uint32_t i = 0; i < 15; i++) {
+        owner.put(i);
+    }
+    MOTATE_CHECK(buffer.count() == 15);
+    MOTATE_CHECK(buffer.peek() == 0);
+
+    // A whole lap is indistinguishable from empty
+    owner.put(15);
+    MOTATE_CHECK(buffer.count() == 0);
+    MOTATE_CHECK(buffer.isEmpty());
+
+    // A lap and three: the first three were written over by the second lap
+    for (uint32_t i = 16; i < 19; i++) {
+        owner.put(i);
+    }
+    MOTATE_CHECK(buffer.count() == 3);
+    MOTATE_CHECK(buffer.read() == 16);
+    MOTATE_CHECK(buffer.read() == 17);
+
+    // Well behind again, then flush() drops it all and reading carries on in order
+    for (uint32_t i = 19; i < 50; i++) {
+        owner.put(i);
+    }
+    buffer.flush();
+    MOTATE_CHECK(buffer.isEmpty());
+    for (uint32_t i = 50; i < 60; i++) {
+        owner.put(i);
+    }
+    MOTATE_CHECK(buffer.count() == 10);
+    for (uint32_t i = 50; i < 60; i++) {
+        MOTATE_CHECK(buffer.read() == (int16_t)i);
+    }
+    MOTATE_CHECK(buffer.isEmpty());
+}
+
+// Without the hardware for it, init() says so and nothing is read
+void testRefused() {
+    RingOwner owner;
+    owner.refuse = true;
+    TestRing buffer {&owner};
+    MOTATE_CHECK(!buffer.init());
+    MOTATE_CHECK(!buffer.isRunning());
+    MOTATE_CHECK(buffer.isEmpty());
+    buffer.stop();
+    MOTATE_CHECK(owner.stopped == 0);
+}
+
+int main() {
+    testWrap(false);
+    testWrap(true);
+    testOverrun();
+    testRefused();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,68 @@
+/*
+ spi_callback_bench.cpp - Time setting and calling an SPICallback against a std::function
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <functional>
+
+#include "motate_test.h"
+#include "spi_test_hardware.h"
+
+using namespace Motate;
+
+// What a message callback costs, set and then called once per message (as a re-queued message
+// does), with a lambda that captures four pointers. That's too big for std::function to keep
+// inline (in libstdc++), so it allocates each time; SPICallback never does.
+
+static constexpr uint32_t kCalls = 4UL * 1024 * 1024;
+
+static uint32_t a = 1, b = 2, c = 3;
+
+template <typename callback_t>
+uint64_t run() {
+    callback_t callback;
+    uint32_t total = 0;
+    uint32_t *pa = &a, *pb = &b, *pc = &c;
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t i = 0; i < kCalls; i++) {
+        callback = [pa, pb, pc, &total]() { total += *pa + *pb + *pc; };
+        callback();
+        MotateTest::keep(callback);
+    }
+    uint64_t elapsed = MotateTest::ticks() - start;
+    MotateTest::keep(total);
+    return elapsed;
+}
+
+int main() {
+    uint64_t function = run<std::function<void(void)>>();
+    uint64_t spi_callback = run<SPICallback<void(void)>>();
+
+    printf("  std::function: %8.2f %ss/call\n", (double)function / kCalls, MotateTest::ticksName());
+    printf("  SPICallback:   %8.2f %ss/call\n", (double)spi_callback / kCalls, MotateTest::ticksName());
+    return 0;
+}
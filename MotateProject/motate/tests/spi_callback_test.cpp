@@ -0,0 +1,153 @@
+/*
+ spi_callback_test.cpp - Check that SPICallback, and the SPI path that uses it, never allocate
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "motate_test.h"
+#include "spi_test_hardware.h"
+
+using namespace Motate;
+
+// The SPI interrupt path can't allocate, which is why it uses SPICallback and not std::function.
+// Every operator new in this program is counted, and the counts have to stay the same while
+// callbacks are set, copied and called, and while messages go through the bus -- including ones
+// re-queued from their callbacks and SPIPeriodicJobs.
+
+static uint32_t allocations = 0;
+
+void *operator new(std::size_t size) {
+    allocations++;
+    void *memory = malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { free(memory); }
+
+// The messages' callbacks are SPICallbacks: the size is fixed, and they copy like plain data
+static_assert(std::is_same<decltype(SPIMessage::message_done_callback), SPICallback<void(void)>>::value,
+              "SPIMessage's callback should be an SPICallback");
+static_assert(sizeof(SPICallback<void(void)>) == 5 * sizeof(void *),
+              "SPICallback should be its storage and one function pointer");
+static_assert(std::is_trivially_copyable<SPICallback<void(void)>>::value &&
+              std::is_trivially_destructible<SPICallback<void(void)>>::value,
+              "SPICallback should copy and go away without any calls");
+
+typedef SPIBus<0, 1, 2> TestBus;
+typedef TestBus::SPIBusDevice TestDevice;
+
+struct TestCS {
+    uint32_t csNumber;
+    uint32_t csValue;
+    bool usesDecoder;
+};
+
+static uint32_t plain_calls = 0;
+void plainFunction() { plain_calls++; };
+
+// As large as fits: four pointers
+struct FullFunctor {
+    uint32_t *a, *b, *c, *d;
+    int operator()(int x) const { return x + *a + *b + *c + *d; };
+};
+
+void testCallback() {
+    uint32_t before = allocations;
+
+    uint32_t one = 1;
+    int k = 7;
+    SPICallback<void(void)> plain = plainFunction;
+    SPICallback<int(int)> capture = [k](int x) { return x * k; };
+    SPICallback<int(int)> full = FullFunctor{&one, &one, &one, &one};
+    SPICallback<int(int)> copy = capture;
+    SPICallback<void(void)> empty;
+
+    plain();
+    MOTATE_CHECK(plain_calls == 1);
+    MOTATE_CHECK(capture(6) == 42);
+    MOTATE_CHECK(copy(2) == 14);
+    MOTATE_CHECK(full(1) == 5);
+    MOTATE_CHECK(!empty && plain);
+
+    copy = full;
+    MOTATE_CHECK(copy(0) == 4);
+    copy = nullptr;
+    MOTATE_CHECK(!copy);
+
+    MOTATE_CHECK(allocations == before);
+};
+
+void testBusPath() {
+    static TestBus bus;
+    bus.init();
+    bus.hardware.keep_log = false; // the log is a std::string
+    TestDevice polled {&bus, TestCS{0, 0, false}, 4000000, kSPIMode0, 0, 0, 0};
+    TestDevice sensor {&bus, TestCS{1, 1, false}, 4000000, kSPIMode0, 0, 0, 0};
+    static const uint8_t kCommand[4] = {'r', 0, 0, 0};
+    SPIPeriodicJob<4> job;
+    job.init(&sensor, kCommand);
+
+    SPIMessage message;
+    uint8_t tx = 'p', rx;
+    message.setup(&tx, &rx, 1, SPIMessage::DeassertAfter, SPIMessage::EndTransaction);
+    uint32_t polls = 0;
+    message.message_done_callback = [&]() {
+        if (++polls < 100) {
+            polled.queueMessage(&message);
+        }
+        job.trigger();
+    };
+
+    uint32_t before = allocations;
+    polled.queueMessage(&message);
+    while (bus.hardware.busy) {
+        bus.hardware.finishTransfer();
+    }
+    MOTATE_CHECK(polls == 100);
+    MOTATE_CHECK(job.sequence() > 0);
+    MOTATE_CHECK(allocations == before);
+};
+
+int main() {
+    // make sure the counting operator new is the one in use
+    uint32_t before = allocations;
+    {
+        std::string allocates(100, 'x');
+        MotateTest::keep(allocates);
+    }
+    MOTATE_CHECK(allocations > before);
+
+    testCallback();
+    testBusPath();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,91 @@
+/*
+ spi_dispatch_bench.cpp - Time queueing and sending SPI messages with more and more devices on the bus
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <deque>
+
+#include "motate_test.h"
+#include "spi_test_hardware.h"
+
+using namespace Motate;
+
+// Every device on the bus queues a message, then they're all sent, over and over. Queueing and
+// picking the next message are O(1), so the cost per message should stay about the same from one
+// device to 256 (the devices are spread over the priorities, so those lists are used too).
+
+typedef SPIBus<0, 1, 2> TestBus;
+typedef TestBus::SPIBusDevice TestDevice;
+
+struct TestCS {
+    uint32_t csNumber;
+    uint32_t csValue;
+    bool usesDecoder;
+};
+
+static constexpr uint32_t kMessages = 1024UL * 1024;
+static constexpr uint32_t kMaxDevices = 256;
+
+static uint8_t tx_value = 'x';
+static SPIMessage messages[kMaxDevices];
+
+uint64_t run(const uint32_t device_count) {
+    static TestBus bus;
+    bus.init();
+    bus.hardware.keep_log = false;
+    std::deque<TestDevice> devices; // grows without moving them (they're on the bus by address)
+    for (uint32_t i = 0; i < device_count; i++) {
+        devices.emplace_back(&bus, TestCS{i, i, false}, 4000000, kSPIMode0, 0, 0, 0);
+        devices.back().setPriority(i % kSPIPriorityLevels);
+        messages[i].setup(&tx_value, nullptr, 1, SPIMessage::DeassertAfter, SPIMessage::EndTransaction);
+    }
+
+    uint64_t start = MotateTest::ticks();
+    for (uint32_t sent = 0; sent < kMessages; sent += device_count) {
+        for (uint32_t i = 0; i < device_count; i++) {
+            devices[i].queueMessage(&messages[i]);
+        }
+        while (bus.hardware.busy) {
+            bus.hardware.finishTransfer();
+        }
+    }
+    uint64_t elapsed = MotateTest::ticks() - start;
+
+    if (bus.hardware.transfers < kMessages) {
+        printf("  only %u of %u messages were sent\n", bus.hardware.transfers, kMessages);
+    }
+    bus.hardware.transfers = 0;
+    return elapsed;
+}
+
+int main() {
+    for (uint32_t device_count = 1; device_count <= kMaxDevices; device_count *= 4) {
+        uint64_t elapsed = run(device_count);
+        printf("  %3u devices: %8.2f %ss/message\n", device_count, (double)elapsed / kMessages, MotateTest::ticksName());
+    }
+    return 0;
+}
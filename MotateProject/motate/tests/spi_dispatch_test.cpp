@@ -0,0 +1,238 @@
+/*
+ spi_dispatch_test.cpp - Check the order SPIBus sends queued messages in
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <deque>
+
+#include "motate_test.h"
+#include "spi_test_hardware.h"
+
+using namespace Motate;
+
+// SPIBus keeps a FIFO of messages per device, and a FIFO of devices waiting for a turn per
+// priority. These run it against TestSPIHardware and check the log of what was sent:
+// round-robin a transaction at a time, the callback re-queueing, priorities and preemption,
+// chaining into the next transfer, and a bus with a lot of devices on it.
+
+typedef SPIBus<0, 1, 2> TestBus;
+typedef TestBus::SPIBusDevice TestDevice;
+
+struct TestCS {
+    uint32_t csNumber;
+    uint32_t csValue;
+    bool usesDecoder;
+};
+
+TestDevice makeDevice(TestBus &bus, const uint32_t cs) {
+    return {&bus, TestCS{cs, cs, false}, 4000000, kSPIMode0, 0, 0, 0};
+};
+
+// A one-value message that sends label, and deasserts after
+struct TestMessage : SPIMessage {
+    uint8_t tx;
+    uint8_t rx;
+
+    TestMessage *set(const char label, const bool ends_transaction = SPIMessage::EndTransaction, const bool with_rx = false) {
+        tx = label;
+        setup(&tx, with_rx ? &rx : nullptr, 1, SPIMessage::DeassertAfter, ends_transaction);
+        return this;
+    };
+};
+
+void runAll(TestBus &bus) {
+    while (bus.hardware.busy) {
+        bus.hardware.finishTransfer();
+    }
+};
+
+void testRoundRobin() {
+    static TestBus bus;
+    bus.init();
+    TestDevice a = makeDevice(bus, 0), b = makeDevice(bus, 1), c = makeDevice(bus, 2);
+    TestMessage m[6];
+
+    // a's first message goes straight out. b and c get in line behind a, and each gets one
+    // transaction before a has another turn -- except that 1 keeps a's transaction open, so 2
+    // (queued while 1 is sending) goes before anyone else.
+    a.queueMessage(m[0].set('0'));
+    b.queueMessage(m[3].set('3'));
+    b.queueMessage(m[4].set('4'));
+    c.queueMessage(m[5].set('5'));
+    a.queueMessage(m[1].set('1', SPIMessage::KeepTransaction));
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:0 1:3 2:5 0:1 ");
+    a.queueMessage(m[2].set('2'));
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:0 1:3 2:5 0:1 0:2 1:4 ");
+};
+
+void testCallbackRequeue() {
+    static TestBus bus;
+    bus.init();
+    TestDevice a = makeDevice(bus, 0), b = makeDevice(bus, 1);
+    TestMessage poll, other;
+
+    // a polls by re-queueing from the callback, which puts it at the back of the line
+    int polls = 0;
+    poll.set('p');
+    poll.message_done_callback = [&]() {
+        if (++polls < 3) {
+            a.queueMessage(&poll);
+        }
+    };
+    a.queueMessage(&poll);
+    b.queueMessage(other.set('o'));
+    runAll(bus);
+    MOTATE_CHECK(polls == 3);
+    MOTATE_CHECK(bus.hardware.log == "0:p 1:o 0:p 0:p ");
+};
+
+void testPriority() {
+    static TestBus bus;
+    bus.init();
+    TestDevice low = makeDevice(bus, 0), high = makeDevice(bus, 1), normal = makeDevice(bus, 2);
+    low.setPriority(kSPIPriorityLow);
+    high.setPriority(kSPIPriorityHigh);
+    TestMessage l[3], h, n;
+
+    // low has the bus, and its transaction isn't preemptible, so high waits for it to end
+    low.queueMessage(l[0].set('a', SPIMessage::KeepTransaction));
+    low.queueMessage(l[1].set('b'));
+    normal.queueMessage(n.set('n'));
+    high.queueMessage(h.set('h'));
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:a 0:b 1:h 2:n ");
+
+    // now it's preemptible: high takes over after the message that deasserts, then low resumes
+    // ahead of anything else at its priority
+    bus.hardware.log.clear();
+    low.setPriority(kSPIPriorityLow, /*preemptible =*/ true);
+    low.queueMessage(l[0].set('a', SPIMessage::KeepTransaction));
+    low.queueMessage(l[1].set('b', SPIMessage::KeepTransaction));
+    low.queueMessage(l[2].set('c'));
+    high.queueMessage(h.set('h'));
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:a 1:h 0:b 0:c ");
+};
+
+void testChaining() {
+    static TestBus bus;
+    bus.init();
+    TestDevice a = makeDevice(bus, 0), b = makeDevice(bus, 1);
+    TestMessage m[3], other;
+
+    // A message that keeps the transaction open and stays asserted has the next one from the
+    // same device loaded behind it, so both finish in the one interrupt
+    m[0].set('0', SPIMessage::KeepTransaction, /*with_rx =*/ true);
+    m[0].deassert_after = SPIMessage::RemainAsserted;
+    m[1].set('1', SPIMessage::KeepTransaction, /*with_rx =*/ true);
+    m[1].deassert_after = SPIMessage::RemainAsserted;
+    m[2].set('2', SPIMessage::EndTransaction, /*with_rx =*/ true);
+    a.queueMessage(&m[0]);
+    b.queueMessage(other.set('o'));
+    a.queueMessage(&m[1]);
+    a.queueMessage(&m[2]);
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 ");
+    bus.hardware.finishTransfer();
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 0:2 ");
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 0:2 1:o ");
+    MOTATE_CHECK(!m[0].sending && !m[1].sending && !m[2].sending);
+};
+
+// A chained-ahead message's callback can still end the transaction, or deassert, but the
+// message chained behind it is already out, so that happens after that one. The device mustn't
+// be left in line (or holding the bus) with nothing to send.
+void testChainedCallbackEndsTransaction() {
+    static TestBus bus;
+    bus.init();
+    TestDevice a = makeDevice(bus, 0), b = makeDevice(bus, 1);
+    TestMessage m[2], other[2];
+
+    m[0].set('0', SPIMessage::KeepTransaction, /*with_rx =*/ true);
+    m[0].deassert_after = SPIMessage::RemainAsserted;
+    m[0].message_done_callback = [&]() {
+        m[0].immediate_ends_transaction = true;
+        m[0].immediate_deassert_after = true;
+    };
+    m[1].set('1', SPIMessage::KeepTransaction, /*with_rx =*/ true);
+    m[1].deassert_after = SPIMessage::RemainAsserted;
+    a.queueMessage(&m[0]);
+    a.queueMessage(&m[1]);
+    b.queueMessage(other[0].set('o'));
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 ");
+
+    bus.hardware.deasserts = 0;
+    bus.hardware.finishTransfer();
+    MOTATE_CHECK(bus.hardware.deasserts == 1);
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 1:o ");
+    runAll(bus);
+    MOTATE_CHECK(bus._ready_priorities == 0);
+    MOTATE_CHECK(!a._ready);
+
+    // and the bus is free for whoever's next
+    b.queueMessage(other[1].set('p'));
+    MOTATE_CHECK(bus.hardware.log == "0:0 +0:1 1:o 1:p ");
+    runAll(bus);
+    MOTATE_CHECK(bus._current_transaction_device == nullptr);
+};
+
+// With many devices waiting, each still goes in the order it got in line, and a device with a
+// second transaction goes to the back rather than being found again by a scan from the front.
+void testManyDevices() {
+    static const uint32_t kDevices = 64;
+    static TestBus bus;
+    bus.init();
+    std::deque<TestDevice> devices; // grows without moving them (they're on the bus by address)
+    static TestMessage first[kDevices], second;
+    for (uint32_t i = 0; i < kDevices; i++) {
+        devices.emplace_back(&bus, TestCS{i, i, false}, 4000000, kSPIMode0, 0, 0, 0);
+    }
+
+    std::string expected;
+    for (uint32_t i = 0; i < kDevices; i++) {
+        devices[i].queueMessage(first[i].set('x'));
+        expected += std::to_string(i) + ":x ";
+    }
+    devices[0].queueMessage(second.set('y'));
+    expected += "0:y ";
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == expected);
+    MOTATE_CHECK(bus.hardware.transfers == kDevices + 1);
+    MOTATE_CHECK(bus._ready_priorities == 0);
+};
+
+int main() {
+    testRoundRobin();
+    testCallbackRequeue();
+    testPriority();
+    testChaining();
+    testChainedCallbackEndsTransaction();
+    testManyDevices();
+    return MotateTest::testResult();
+}
@@ -0,0 +1,212 @@
+/*
+ spi_periodic_test.cpp - Check that SPIPeriodicJob is queued by the SPI interrupt, not by trigger()
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "motate_test.h"
+#include "spi_test_hardware.h"
+
+using namespace Motate;
+
+// trigger() is called from a timer interrupt, which can come in the middle of anything --
+// including the main loop queueing a message, with the SPI interrupt masked. So trigger() only
+// puts the job on the bus's triggered list and pends the SPI interrupt, and the queueing is done
+// there. These call trigger() at those points (from TestSPIHardware's when_masked hook, and from
+// a message callback) and check that the job goes out after, with nothing nested.
+
+typedef SPIBus<0, 1, 2> TestBus;
+typedef TestBus::SPIBusDevice TestDevice;
+
+struct TestCS {
+    uint32_t csNumber;
+    uint32_t csValue;
+    bool usesDecoder;
+};
+
+TestDevice makeDevice(TestBus &bus, const uint32_t cs) {
+    return {&bus, TestCS{cs, cs, false}, 4000000, kSPIMode0, 0, 0, 0};
+};
+
+static const uint8_t kCommand[4] = {'r', 1, 2, 3};
+
+void runAll(TestBus &bus) {
+    while (bus.hardware.busy) {
+        bus.hardware.finishTransfer();
+    }
+};
+
+void testTrigger() {
+    static TestBus bus;
+    bus.init();
+    TestDevice sensor = makeDevice(bus, 0);
+    SPIPeriodicJob<4> job;
+    job.init(&sensor, kCommand);
+
+    uint8_t reply[4];
+    MOTATE_CHECK(job.read(reply) == 0);
+
+    for (uint8_t k = 1; k <= 3; k++) {
+        bus.hardware.reply = k;
+        job.trigger();
+        // nothing is queued until the SPI interrupt gets to it
+        MOTATE_CHECK(bus.hardware.pending);
+        MOTATE_CHECK(sensor._first_message == nullptr);
+        MOTATE_CHECK(!bus.hardware.busy);
+        bus.hardware.runPendingInterrupt();
+        MOTATE_CHECK(bus.hardware.busy);
+
+        job.trigger(); // still going, so skipped
+        MOTATE_CHECK(job.skipped() == k);
+        MOTATE_CHECK(job.read(reply) == (uint32_t)(k - 1));
+
+        runAll(bus);
+        MOTATE_CHECK(job.read(reply) == k);
+        MOTATE_CHECK(reply[0] == k && reply[3] == k);
+    }
+    MOTATE_CHECK(bus.hardware.log == "0:r 0:r 0:r ");
+};
+
+// The "timer" comes while the main loop has the SPI interrupt masked to queue a message
+void testTriggerWhileQueueing() {
+    static TestBus bus;
+    bus.init();
+    TestDevice sensor = makeDevice(bus, 0), other = makeDevice(bus, 1);
+    SPIPeriodicJob<4> job;
+    job.init(&sensor, kCommand);
+    SPIMessage message;
+    uint8_t tx = 'o';
+    message.setup(&tx, nullptr, 1, SPIMessage::DeassertAfter, SPIMessage::EndTransaction);
+
+    bool triggered = false;
+    bus.hardware.when_masked = [&]() {
+        job.trigger();
+        triggered = true;
+        // the bus is the main loop's until it unmasks
+        MOTATE_CHECK(sensor._first_message == nullptr);
+        MOTATE_CHECK(bus._ready_priorities == 0);
+    };
+    other.queueMessage(&message);
+    MOTATE_CHECK(triggered);
+    // unmasking ran the pended interrupt, which queued the job behind the main loop's message
+    MOTATE_CHECK(!bus.hardware.pending);
+    MOTATE_CHECK(sensor._first_message == &job._message);
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "1:o 0:r ");
+    MOTATE_CHECK(job.sequence() == 1);
+    MOTATE_CHECK(bus.hardware.nested_masks == 0);
+};
+
+// The "timer" comes while the SPI interrupt is running (here, in a message callback)
+void testTriggerInInterrupt() {
+    static TestBus bus;
+    bus.init();
+    TestDevice sensor = makeDevice(bus, 0), other = makeDevice(bus, 1);
+    SPIPeriodicJob<4> job;
+    job.init(&sensor, kCommand);
+    SPIMessage message;
+    uint8_t tx = 'o';
+    message.setup(&tx, nullptr, 1, SPIMessage::DeassertAfter, SPIMessage::EndTransaction);
+    message.message_done_callback = [&]() {
+        job.trigger();
+        MOTATE_CHECK(sensor._first_message == nullptr);
+    };
+
+    other.queueMessage(&message);
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "1:o 0:r ");
+    MOTATE_CHECK(job.sequence() == 1);
+    MOTATE_CHECK(bus.hardware.nested_masks == 0);
+};
+
+// Two jobs on two devices, triggered together, are both queued by one interrupt
+void testTwoJobs() {
+    static TestBus bus;
+    bus.init();
+    TestDevice first = makeDevice(bus, 0), second = makeDevice(bus, 1);
+    SPIPeriodicJob<4> first_job, second_job;
+    static const uint8_t kOtherCommand[4] = {'s', 0, 0, 0};
+    first_job.init(&first, kCommand);
+    second_job.init(&second, kOtherCommand);
+
+    first_job.trigger();
+    second_job.trigger();
+    bus.hardware.runPendingInterrupt();
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:r 1:s ");
+    MOTATE_CHECK(first_job.sequence() == 1 && second_job.sequence() == 1);
+
+    // they go in the order they were triggered, not the order of the devices
+    second_job.trigger();
+    first_job.trigger();
+    bus.hardware.runPendingInterrupt();
+    runAll(bus);
+    MOTATE_CHECK(bus.hardware.log == "0:r 1:s 1:s 0:r ");
+};
+
+// Counts the times the interrupt looked at it
+struct CountedJob : SPIPeriodicJob<4> {
+    uint32_t queued = 0;
+    void _queueTriggered() override {
+        queued++;
+        SPIPeriodicJob<4>::_queueTriggered();
+    };
+};
+
+// With a lot of jobs on the bus, the interrupt only looks at the ones that were triggered
+void testManyJobs() {
+    static const uint32_t kJobs = 64;
+    static TestBus bus;
+    bus.init();
+    TestDevice sensor = makeDevice(bus, 0);
+    static CountedJob jobs[kJobs];
+    for (uint32_t i = 0; i < kJobs; i++) {
+        jobs[i].init(&sensor, kCommand);
+    }
+
+    jobs[5].trigger();
+    jobs[40].trigger();
+    bus.hardware.runPendingInterrupt();
+    runAll(bus);
+
+    uint32_t looked_at = 0;
+    for (uint32_t i = 0; i < kJobs; i++) {
+        looked_at += jobs[i].queued;
+    }
+    MOTATE_CHECK(looked_at == 2);
+    MOTATE_CHECK(jobs[5].sequence() == 1 && jobs[40].sequence() == 1);
+    MOTATE_CHECK(bus.hardware.transfers == 2);
+    MOTATE_CHECK(bus._triggered_jobs.load() == nullptr);
+};
+
+int main() {
+    testTrigger();
+    testTriggerWhileQueueing();
+    testTriggerInInterrupt();
+    testTwoJobs();
+    testManyJobs();
+    return MotateTest::testResult();
+}
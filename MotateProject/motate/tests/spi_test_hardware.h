@@ -0,0 +1,188 @@
+/*
+ spi_test_hardware.h - A host stand-in for the SPI hardware, to run SPIBus in the tests
+ http://github.com/synthetos/motate/
+
+ Copyright (c) 2016 Robert Giseburt
+
+ This file is part of the Motate Library.
+
+ This file ("the software") is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License, version 2 as published by the
+ Free Software Foundation. You should have received a copy of the GNU General Public
+ License, version 2 along with the software. If not, see <http://www.gnu.org/licenses/>.
+
+ As a special exception, you may use this file as part of a software library without
+ restriction. Specifically, if other files instantiate templates or use macros or
+ inline functions from this file, or you compile this file and link it with  other
+ files to produce an executable, this file does not by itself cause the resulting
+ executable to be covered by the GNU General Public License. This exception does not
+ however invalidate any other reasons why the executable file might be covered by the
+ GNU General Public License.
+
+ THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPI_TEST_HARDWARE_H_ONCE
+#define SPI_TEST_HARDWARE_H_ONCE
+
+// MotateSPI.h gets its hardware from the processor-specific header (SamSPI.h and so on), which
+// needs the real registers. Include this first instead, and SPIBus gets TestSPIHardware: the
+// pins are all "on SPI 0", a transfer runs until the test calls finishTransfer(), and what was
+// sent is kept in a log the tests can compare against.
+//
+// The interrupt is modelled as on the NVIC: it can be masked, and pended to run when it's
+// unmasked (or when the test calls runPendingInterrupt(), standing in for whatever interrupt
+// pended it returning). It never runs inside itself.
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+namespace Motate {
+    typedef const int16_t pin_number;
+
+    static const uint32_t kInterruptPriorityLow = 0;
+
+    template<pin_number> constexpr bool IsSPIMISOPin() { return true; };
+    template<pin_number> constexpr bool IsSPIMOSIPin() { return true; };
+    template<pin_number> constexpr bool IsSPISCKPin() { return true; };
+    template<pin_number> struct SPIMISOPin { static const uint8_t spiNum = 0; };
+    template<pin_number> struct SPIMOSIPin { static const uint8_t spiNum = 0; };
+    template<pin_number> struct SPISCKPin { static const uint8_t spiNum = 0; };
+
+    struct TestSPIHardware {
+        std::function<void(uint16_t)> _handler;
+
+        uint32_t channel = 0;
+        bool busy = false;         // a transfer is running
+        bool next_loaded = false;  // ... and one is queued behind it (see startNextTransfer())
+        uint32_t transfers = 0;
+        uint8_t reply = 0;         // what the "device" sends back, into each rx_buffer
+        uint32_t deasserts = 0;    // calls to deassert()
+
+        bool masked = false;
+        bool pending = false;
+        bool in_interrupt = false;
+        uint32_t nested_masks = 0;      // masked while already masked: the inner unmask would end it early
+        std::function<void()> when_masked; // run (once) the next time the interrupt is masked
+
+        // Each transfer adds "<channel>:<first tx byte>", or "+<channel>:<byte>" if chained, and a
+        // space. Only kept while keep_log is set (the benchmarks turn it off).
+        std::string log;
+        bool keep_log = true;
+
+        void init() {};
+        void enable() {};
+        void setUsingCSDecoder(bool) {};
+        void setChannelOptions(uint32_t, uint32_t, uint16_t, uint32_t, uint32_t, uint32_t) {};
+        template <typename handler_t>
+        void setInterruptHandler(handler_t &&handler) { _handler = std::forward<handler_t>(handler); };
+        void setInterrupts(uint32_t) {};
+        void setChannel(uint32_t new_channel) { channel = new_channel; };
+        void deassert() { deasserts++; };
+        void _disableOnTXTransferDoneInterrupt() {};
+        void _disableOnRXTransferDoneInterrupt() {};
+
+        void _setInterruptMasked(bool mask) {
+            if (!mask) {
+                masked = false;
+                runPendingInterrupt();
+                return;
+            }
+            if (masked) {
+                nested_masks++;
+            }
+            masked = true;
+            if (when_masked) {
+                std::function<void()> hook = std::move(when_masked);
+                when_masked = nullptr;
+                hook();
+            }
+        };
+
+        void _setInterruptPending() { pending = true; };
+
+        void _interrupt(uint16_t cause) {
+            in_interrupt = true;
+            _handler(cause);
+            in_interrupt = false;
+        };
+
+        // If it's pended and can run, run the interrupt (with no cause, as on the hardware)
+        void runPendingInterrupt();
+
+        static constexpr bool canChainTransfers() { return true; };
+
+        void _logTransfer(const char *prefix, const uint8_t *tx_buffer) {
+            transfers++;
+            if (keep_log) {
+                log += prefix;
+                log += std::to_string(channel);
+                log += ':';
+                log += (char)tx_buffer[0];
+                log += ' ';
+            }
+        };
+
+        void _fillReply(uint8_t *rx_buffer, uint16_t size) {
+            for (uint16_t i = 0; rx_buffer && (i < size); i++) {
+                rx_buffer[i] = reply;
+            }
+        };
+
+        bool startTransfer(uint8_t *tx_buffer, uint8_t *rx_buffer, uint16_t size) {
+            _fillReply(rx_buffer, size);
+            busy = true;
+            next_loaded = false;
+            _logTransfer("", tx_buffer);
+            return true;
+        };
+
+        // Like the PDC next registers: one transfer can wait behind the running one
+        bool startNextTransfer(uint8_t *tx_buffer, uint8_t *rx_buffer, uint16_t size) {
+            if (!busy || next_loaded || (rx_buffer == nullptr)) {
+                return false;
+            }
+            _fillReply(rx_buffer, size);
+            next_loaded = true;
+            _logTransfer("+", tx_buffer);
+            return true;
+        };
+
+        // The running transfer (and any chained one) is done: run the interrupt
+        void finishTransfer();
+    };
+
+    template<pin_number, pin_number, pin_number>
+    using SPIGetHardware = TestSPIHardware;
+} // namespace Motate
+
+// The ARM build (Motate.mk) doesn't use -Wextra, so the unused parameters of SPIBusDeviceBase's
+// default virtual functions would only be noise here
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#include "MotateSPI.h"
+#pragma GCC diagnostic pop
+
+namespace Motate {
+    inline void TestSPIHardware::runPendingInterrupt() {
+        while (pending && !masked && !in_interrupt) {
+            pending = false;
+            _interrupt(SPIInterrupt::Unknown);
+        }
+    };
+
+    inline void TestSPIHardware::finishTransfer() {
+        busy = false;
+        next_loaded = false;
+        _interrupt(SPIInterrupt::OnTxTransferDone);
+        runPendingInterrupt();
+    };
+} // namespace Motate
+
+#endif /* end of include guard: SPI_TEST_HARDWARE_H_ONCE */